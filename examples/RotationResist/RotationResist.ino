@@ -5,7 +5,9 @@ rotation.
 Be careful to not move the robot for a few seconds after starting
 it while the gyro is being calibrated.  During the gyro
 calibration, the yellow LED is on and the words "Gyro cal" are
-displayed on the display.
+displayed on the display.  The result is saved in flash, so later
+runs skip the calibration.  Hold button B while starting the robot
+to calibrate again.
 
 After the gyro calibration is done, press button A to start the
 demo.  If you try to turn the 3pi+, or put it on a surface that
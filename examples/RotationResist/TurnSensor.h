@@ -4,7 +4,7 @@
 //
 // This file should be included *once* in your sketch,
 // somewhere after you define objects named buttonA,
-// display, and imu.
+// buttonB, display, and imu.
 
 #include <Wire.h>
 
@@ -96,28 +96,37 @@ void turnSensorSetup()
   imu.enableDefault();
   imu.configureForTurnSensing();
 
-  display.clear();
-  display.print("Gyro cal");
-
-  // Turn on the yellow LED in case the display is not available.
-  ledYellow(1);
-
-  // Delay to give the user time to remove their finger.
-  delay(500);
-
-  // Calibrate the gyro.
-  int32_t total = 0;
-  for (uint16_t i = 0; i < 1024; i++)
+  // Use the gyro offset saved in flash by an earlier run if there
+  // is one, unless button B is held down to force a new
+  // calibration.
+  if (buttonB.isPressed() || !imu.loadGyroOffset(gyroOffset))
   {
-    // Wait for new data to be available, then read it.
-    while(!imu.gyroDataReady()) {}
-    imu.readGyro();
-
-    // Add the Z axis reading to the total.
-    total += imu.g.z;
+    display.clear();
+    display.print("Gyro cal");
+
+    // Turn on the yellow LED in case the display is not available.
+    ledYellow(1);
+
+    // Delay to give the user time to remove their finger.
+    delay(500);
+
+    // Calibrate the gyro.
+    int32_t total = 0;
+    for (uint16_t i = 0; i < 1024; i++)
+    {
+      // Wait for new data to be available, then read it.
+      while(!imu.gyroDataReady()) {}
+      imu.readGyro();
+
+      // Add the Z axis reading to the total.
+      total += imu.g.z;
+    }
+    ledYellow(0);
+    gyroOffset = total / 1024;
+
+    // Save the offset so that the next run can skip calibrating.
+    imu.saveGyroOffset(gyroOffset);
   }
-  ledYellow(0);
-  gyroOffset = total / 1024;
 
   // Display the angle (in degrees from -180 to 180) until the
   // user presses A.
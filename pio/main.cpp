@@ -16,13 +16,16 @@
 #include <stdio.h>
 #include <hardware/pio.h>
 #include <RP2040QTR.pio.h>
-#include <RP2040Encoders.pio.h>
+#include <RP2040DualEncoders.pio.h>
 
 
 int main(void)
 {
-    pio_add_program(pio0, &RP2040QTR_program);
-    pio_add_program(pio1, &RP2040Encoders_program);
+    // Both QTR programs won't fit in the same PIO at once.
+    uint qtrOffset = pio_add_program(pio0, &RP2040QTR_program);
+    pio_remove_program(pio0, &RP2040QTR_program, qtrOffset);
+    pio_add_program(pio0, &RP2040QTREarlyExit_program);
+    pio_add_program(pio1, &RP2040DualEncoders_program);
 
     return 0;
 }
@@ -15,12 +15,18 @@
 #include "Pololu3piPlus2040BumpSensors.h"
 #include "Pololu3piPlus2040Buttons.h"
 #include "Pololu3piPlus2040Buzzer.h"
+#include "Pololu3piPlus2040Calibration.h"
 #include "Pololu3piPlus2040Encoders.h"
 #include "Pololu3piPlus2040IMU.h"
 #include "Pololu3piPlus2040LEDs.h"
+#include "Pololu3piPlus2040LightSensors.h"
 #include "Pololu3piPlus2040LineSensors.h"
+#include "Pololu3piPlus2040MotionProfile.h"
 #include "Pololu3piPlus2040Motors.h"
 #include "Pololu3piPlus2040OLED.h"
+#include "Pololu3piPlus2040RobotFrame.h"
+#include "Pololu3piPlus2040SensorService.h"
+#include "Pololu3piPlus2040WheelSpeedController.h"
 
 
 /// Top-level namespace for the Pololu3piPlus2040 library.
@@ -28,6 +34,10 @@ namespace Pololu3piPlus2040
 {
 
 /// Reads the battery voltage and returns it in millivolts.
+///
+/// The reading is also passed to Motors::updateBatteryMillivolts() for
+/// battery compensation. Don't call this while the SensorService is running,
+/// since core1 controls the line sensor emitters on the same pin.
 uint16_t readBatteryMillivolts()
 {
     // Pin 26 is shared with the down emitter. The code in the LineSensors class will reconfigure to SIO mode
@@ -42,7 +52,9 @@ uint16_t readBatteryMillivolts()
 
     // The voltage divider steps the voltage down by 1/11th of the actual battery voltage.
     // The analogRead readings fall in a 10-bit range.
-    return (3300 * sum * 11 + sampleCount * 511) / (sampleCount * 1023);
+    uint16_t millivolts = (3300 * sum * 11 + sampleCount * 511) / (sampleCount * 1023);
+    Motors::updateBatteryMillivolts(millivolts);
+    return millivolts;
 }
 
 }
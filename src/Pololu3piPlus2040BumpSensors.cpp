@@ -1,6 +1,7 @@
 // Copyright (C) Pololu Corporation.  See www.pololu.com for details.
 
 #include "Pololu3piPlus2040BumpSensors.h"
+#include "Pololu3piPlus2040LightSensors.h"
 #include "RP2040SIO.h"
 
 namespace Pololu3piPlus2040
@@ -8,43 +9,175 @@ namespace Pololu3piPlus2040
 
 void BumpSensors::readRaw()
 {
+  // Complete any read that was previously started with beginRead() before starting this one.
+  if (readPending)
+  {
+    finishRead();
+  }
+
+  // The line sensors or LightSensors can have their own read pending on the shared QTR. Finish it for them, with
+  // the line emitters off for this read as they would be if it were done on its own, and give them back their
+  // results afterwards.
+  QTRSensorReadings otherReadings;
+  bool otherReadPending = pQTR->takePendingRead(otherReadings);
+  if (otherReadPending)
+  {
+    lineEmitterPin.init(false, false, false, false);
+  }
+
+  if (beginRead())
+  {
+    finishReadRaw();
+  }
+
+  if (otherReadPending)
+  {
+    pQTR->holdReadings(otherReadings);
+  }
+}
+
+void BumpSensors::finishReadRaw()
+{
+  if (!readPending)
+  {
+    return;
+  }
+
+  while (!isReadComplete())
+  {
+  }
+  sensorValues = pQTR->finishRead().bumperReadings;
+  readPending = false;
+}
+
+bool BumpSensors::beginRead()
+{
+  // The QTR state machine is shared with the line sensors so only one read can be in progress at a time.
+  if (readPending || pQTR->isReadPending())
+  {
+    return false;
+  }
+
+  // Only the two bump sensors need to be charged and timed.
   emitterPin.setOutputHigh();
-  QTRSensorReadings readings = pQTR->read();
+  pQTR->startRead(QTRSensors::BUMP_SENSORS_MASK);
+  readPending = true;
+  return true;
+}
+
+bool BumpSensors::isReadComplete()
+{
+  if (!readPending)
+  {
+    return true;
+  }
+  if (!pQTR->isReadComplete())
+  {
+    return false;
+  }
+
+  // Turn the emitters off as soon as the discharge has been timed instead of waiting for finishRead().
   emitterPin.setInput();
+  return true;
+}
+
+uint8_t BumpSensors::finishRead()
+{
+  finishReadRaw();
 
-  sensorValues = readings.bumperReadings;
+  return updatePressed();
 }
 
 void BumpSensors::calibrate(uint8_t count)
 {
-  BumperSensorReadings sum = { 0, 0 };
+  calibratePrivate(count, NULL, LineSensorsReadMode::Manual);
+}
+
+void BumpSensors::calibrate(LightSensors & lightSensors, uint8_t count, LineSensorsReadMode lineMode)
+{
+  calibratePrivate(count, &lightSensors, lineMode);
+}
+
+void BumpSensors::calibratePrivate(uint8_t count, LightSensors * pLightSensors, LineSensorsReadMode lineMode)
+{
+  // The readings can be as large as 65535 with a long timeout so accumulate them in 32 bits.
+  uint32_t sum[2] = { 0, 0 };
 
   for (uint8_t i = 0; i < count; i++)
   {
-    readRaw();
-    sum.left  += sensorValues.left;
-    sum.right += sensorValues.right;
+    if (pLightSensors)
+    {
+      pLightSensors->read(lineMode);
+      sensorValues = pLightSensors->getReadings().bumperReadings;
+    }
+    else
+    {
+      readRaw();
+    }
+    sum[BumpLeft]  += sensorValues.left;
+    sum[BumpRight] += sensorValues.right;
   }
 
-  for (uint8_t s = 0; s < sizeof(sum.vals)/sizeof(sum.vals[0]); s++)
+  for (uint8_t s = 0; s < sizeof(sum)/sizeof(sum[0]); s++)
   {
-    baseline.vals[s] = (sum.vals[s] + count / 2) / count;
+    baseline.vals[s] = (sum[s] + count / 2) / count;
 
     // Calculate threshold to compare readings to by adding margin to baseline,
     // but make sure it is no larger than the QTR sensor timeout (i.e. if the
     // reading timed out, consider the bump sensor pressed).
-    threshold.vals[s] = baseline.vals[s] + baseline.vals[s] * (uint32_t)marginPercentage / 100;
-    if (threshold.vals[s] > QTRSensors::TIMEOUT)
+    uint32_t value = baseline.vals[s] + baseline.vals[s] * (uint32_t)marginPercentage / 100;
+    if (value > pQTR->getMaxReading())
     {
-      threshold.vals[s] = QTRSensors::TIMEOUT;
+      value = pQTR->getMaxReading();
     }
+    threshold.vals[s] = value;
+  }
+}
+
+bool BumpSensors::saveCalibration()
+{
+  CalibrationRecord record;
+  CalibrationStorage::load(record);
+
+  record.bumpMaxReading = pQTR->getMaxReading();
+  record.bumpBaseline = baseline;
+  record.bumpThreshold = threshold;
+  record.valid |= CalibrationRecord::BUMP_VALID;
+
+  return CalibrationStorage::save(record);
+}
+
+bool BumpSensors::loadCalibration()
+{
+  CalibrationRecord record;
+  if (!CalibrationStorage::load(record) ||
+      !(record.valid & CalibrationRecord::BUMP_VALID) ||
+      record.bumpMaxReading != pQTR->getMaxReading())
+  {
+    return false;
   }
+
+  baseline = record.bumpBaseline;
+  threshold = record.bumpThreshold;
+  return true;
 }
 
 uint8_t BumpSensors::read()
 {
   readRaw();
 
+  return updatePressed();
+}
+
+uint8_t BumpSensors::read(const LightSensors& lightSensors)
+{
+  sensorValues = lightSensors.getReadings().bumperReadings;
+
+  return updatePressed();
+}
+
+uint8_t BumpSensors::updatePressed()
+{
   uint8_t bitField = 0;
   for (uint8_t s = 0; s < sizeof(pressed)/sizeof(pressed[0]); s++)
   {
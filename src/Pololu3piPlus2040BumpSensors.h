@@ -7,10 +7,14 @@
 #include <Arduino.h>
 #include "RP2040SIO.h"
 #include "RP2040QTR.h"
+#include "Pololu3piPlus2040Calibration.h"
+#include "Pololu3piPlus2040LineSensors.h"
 
 namespace Pololu3piPlus2040
 {
 
+class LightSensors;
+
 /// Bump sensor sides.
 enum BumpSide {
   /// Right bump sensor
@@ -26,6 +30,7 @@ class BumpSensors
 {
   private:
     RP2040SIO::Pin<23> emitterPin;
+    RP2040SIO::Pin<26> lineEmitterPin;
 
   public:
     BumpSensors()
@@ -59,6 +64,43 @@ class BumpSensors
     /// \f]
     void calibrate(uint8_t count = 50);
 
+    /// \brief Calibrates the bump sensors through a LightSensors object.
+    ///
+    /// \param lightSensors The LightSensors object to take the readings with.
+    ///
+    /// \param count The number of times to read the sensors during calibration.
+    /// The default is 50.
+    ///
+    /// \param lineMode The line emitter behavior during the readings, as a
+    /// member of the ::LineSensorsReadMode enum. The default is
+    /// LineSensorsReadMode::On.
+    ///
+    /// The line sensor emitters light up the floor in front of the bump
+    /// sensors, so readings taken by LightSensors::read() with them on are
+    /// different from the readings that read() takes. Use this method instead
+    /// of calibrate() when the bump sensors will be read with
+    /// read(const LightSensors&) or from a RobotFrame, passing the same
+    /// \p lineMode that those readings use.
+    void calibrate(LightSensors& lightSensors, uint8_t count = 50,
+                   LineSensorsReadMode lineMode = LineSensorsReadMode::On);
+
+    /// \brief Saves the #baseline and #threshold values from calibrate() to
+    /// flash.
+    ///
+    /// \return True if the calibration was saved successfully.
+    ///
+    /// Any saved line sensor or gyro calibration is kept. This takes about
+    /// 50 ms so call it once after calibrating.
+    bool saveCalibration();
+
+    /// \brief Loads the #baseline and #threshold values from flash.
+    ///
+    /// \return True if they were loaded; false if they were never saved or
+    /// were saved with a different timeout (see LineSensors::setTimeout()).
+    ///
+    /// This lets a program skip calibrate() after a reset.
+    bool loadCalibration();
+
     /// \brief Reads both bump sensors.
     ///
     /// \return A bit field indicating whether each bump sensor is pressed. The
@@ -75,6 +117,44 @@ class BumpSensors
     /// sensors.
     uint8_t read();
 
+    /// \brief Updates the bump sensor states from the most recent
+    /// LightSensors::read() without reading the sensors again.
+    ///
+    /// \param lightSensors The LightSensors object which took the reading.
+    ///
+    /// \return The same bit field as returned by read().
+    ///
+    /// This allows one reading to be shared with the line sensors. See
+    /// LightSensors for more information.
+    uint8_t read(const LightSensors& lightSensors);
+
+    /// \brief Starts reading both bump sensors in the background.
+    ///
+    /// \return True if the read was started; false if a read from these or the
+    /// line sensors is already in progress.
+    ///
+    /// This lets your code do something else while the RP2040's PIO times how
+    /// long the sensors take to discharge. Call isReadComplete() to check
+    /// whether the read is done and finishRead() to obtain the results. The bump
+    /// sensor emitters are turned on and off just like read() does. A blocking
+    /// read of the line sensors made while this read is pending completes it
+    /// first and keeps its results for finishRead().
+    bool beginRead();
+
+    /// \brief Indicates whether the read started by beginRead() has completed.
+    ///
+    /// \return True if the results are ready to be collected with finishRead();
+    /// false otherwise. This method never blocks.
+    bool isReadComplete();
+
+    /// \brief Finishes the read started by beginRead().
+    ///
+    /// \return The same bit field as returned by read().
+    ///
+    /// This method waits for the read to complete if isReadComplete() hasn't
+    /// returned true yet.
+    uint8_t finishRead();
+
     /// \brief Indicates whether the left bump sensor's state has changed.
     ///
     /// \return True if the left bump sensor's state has changed between the
@@ -104,6 +184,9 @@ class BumpSensors
     /// Pointer to the QTR sensor reading singleton shared with the line sensors.
     QTRSensors* pQTR;
 
+    /// Has beginRead() started a read that hasn't been finished yet?
+    bool readPending = false;
+
   public:
     /// \brief The amount, as a percentage, that will be added to the measured
     /// baseline to get the threshold.
@@ -132,6 +215,10 @@ class BumpSensors
     uint8_t last[2];
 
     void readRaw();
+    void finishReadRaw();
+    // The readings are taken through pLightSensors if it isn't NULL.
+    void calibratePrivate(uint8_t count, LightSensors * pLightSensors, LineSensorsReadMode lineMode);
+    uint8_t updatePressed();
 };
 
 }
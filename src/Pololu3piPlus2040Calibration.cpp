@@ -0,0 +1,38 @@
+// Copyright (C) Pololu Corporation.  See www.pololu.com for details.
+
+#include "Pololu3piPlus2040Calibration.h"
+#include "RP2040Flash.h"
+#include "Pololu3piPlus2040SensorService.h"
+
+namespace Pololu3piPlus2040
+{
+
+static_assert(sizeof(CalibrationRecord) <= FlashRecord::maxSize, "CalibrationRecord is too large for flash page");
+
+bool CalibrationStorage::load(CalibrationRecord & record)
+{
+  if (FlashRecord::read(recordId, &record, sizeof(record)))
+  {
+    return true;
+  }
+  memset(&record, 0, sizeof(record));
+  return false;
+}
+
+bool CalibrationStorage::save(const CalibrationRecord & record)
+{
+  // Core1 can't run from flash while it is being written.
+  SensorService::pauseForFlashWrite();
+  bool result = FlashRecord::write(recordId, &record, sizeof(record));
+  SensorService::resumeAfterFlashWrite();
+  return result;
+}
+
+void CalibrationStorage::erase()
+{
+  SensorService::pauseForFlashWrite();
+  FlashRecord::erase();
+  SensorService::resumeAfterFlashWrite();
+}
+
+}
@@ -0,0 +1,99 @@
+// Copyright (C) Pololu Corporation.  See www.pololu.com for details.
+
+/// \file Pololu3piPlus2040Calibration.h
+
+#pragma once
+
+#include <Arduino.h>
+#include "RP2040QTR.h"
+
+namespace Pololu3piPlus2040
+{
+
+/// \brief Calibration data for the sensors on the 3pi+ 2040 which can be
+/// kept in flash so that it doesn't need to be redone after every reset.
+///
+/// You don't normally need to use this directly. Call
+/// LineSensors::saveCalibration(), BumpSensors::saveCalibration(), and
+/// IMU::saveGyroOffset() after calibrating, and the matching load methods at
+/// startup.
+struct CalibrationRecord
+{
+  /// Set in #valid when the line sensor emitters on calibration is present.
+  static const uint8_t LINE_ON_VALID = 1 << 0;
+  /// Set in #valid when the line sensor emitters off calibration is present.
+  static const uint8_t LINE_OFF_VALID = 1 << 1;
+  /// Set in #valid when the bump sensor calibration is present.
+  static const uint8_t BUMP_VALID = 1 << 2;
+  /// Set in #valid when the gyro offset is present.
+  static const uint8_t GYRO_VALID = 1 << 3;
+
+  /// Bit field indicating which parts of the record have been saved.
+  uint8_t valid;
+
+  /// Maximum raw reading of the line sensors when they were calibrated. The
+  /// calibration only applies if the timeout hasn't changed since.
+  uint16_t lineMaxReading;
+  /// LineSensors::calibrationOn minimum values.
+  LineSensorReadings lineOnMinimum;
+  /// LineSensors::calibrationOn maximum values.
+  LineSensorReadings lineOnMaximum;
+  /// LineSensors::calibrationOff minimum values.
+  LineSensorReadings lineOffMinimum;
+  /// LineSensors::calibrationOff maximum values.
+  LineSensorReadings lineOffMaximum;
+
+  /// Maximum raw reading of the bump sensors when they were calibrated.
+  uint16_t bumpMaxReading;
+  /// BumpSensors::baseline values.
+  BumperSensorReadings bumpBaseline;
+  /// BumpSensors::threshold values.
+  BumperSensorReadings bumpThreshold;
+
+  /// Average gyro Z axis reading while the robot is still.
+  int16_t gyroOffset;
+  /// IMUType of the sensors that #gyroOffset was measured with.
+  uint8_t gyroType;
+  /// Gyro output data rate and full scale setting (the LSM6DSO CTRL2_G
+  /// register) that #gyroOffset was measured with. The offset only applies
+  /// if the gyro is configured the same way.
+  uint8_t gyroConfig;
+};
+
+/// \brief Saves a CalibrationRecord in a flash sector set aside for it.
+///
+/// The record is stored with a version number and a CRC so that one which
+/// was never written, is corrupted, or was written by an incompatible
+/// version of this library is ignored. Loading it takes a few microseconds.
+///
+/// By default the last 4 KB sector of the board's flash is used. It can be
+/// moved by defining POLOLU_3PI_PLUS_2040_FLASH_RECORD_OFFSET.
+class CalibrationStorage
+{
+public:
+  /// \brief Loads the saved calibration record.
+  ///
+  /// \param record Receives the saved record. If there isn't a valid one,
+  /// it is cleared to all zeros instead.
+  ///
+  /// \return True if a valid record was loaded; false otherwise.
+  static bool load(CalibrationRecord & record);
+
+  /// \brief Saves a calibration record, replacing the previous one.
+  ///
+  /// \return True if the record was written successfully.
+  ///
+  /// Erasing and writing the flash takes about 50 ms, during which
+  /// interrupts are disabled, so this shouldn't be called while driving.
+  static bool save(const CalibrationRecord & record);
+
+  /// \brief Erases the saved calibration record.
+  static void erase();
+
+private:
+  /// Identifies the record layout: "3pC" and a version number. Increment the
+  /// version whenever CalibrationRecord changes.
+  static const uint32_t recordId = 0x33704302;
+};
+
+}
@@ -1,7 +1,11 @@
 // Copyright (C) Pololu Corporation.  See www.pololu.com for details.
 
+#include <stdlib.h>
+#include <hardware/clocks.h>
+#include <hardware/sync.h>
+#include <hardware/timer.h>
 #include "Pololu3piPlus2040Encoders.h"
-#include "RP2040Encoders.h"
+#include "RP2040DualEncoders.h"
 
 namespace Pololu3piPlus2040
 {
@@ -9,22 +13,61 @@ namespace Pololu3piPlus2040
 // Whether encoder count direction should be flipped.
 static bool g_flip = false;
 
-// This is used to reset the counters.
-static int32_t g_leftReset = 0;
-static int32_t g_rightReset = 0;
+// This is used to reset the counters. They are kept in 64 bits so that the 32-bit counts wrap around correctly
+// however long it has been since the last reset.
+static int64_t g_leftReset = 0;
+static int64_t g_rightReset = 0;
 
-// PIO state machine indices used for each of the encoders.
-static int32_t g_rightIndex = -1;
-static int32_t g_leftIndex = -1;
+// The positions are reset separately from the counts so that resetting the counts doesn't disturb odometry.
+static int64_t g_leftPositionReset = 0;
+static int64_t g_rightPositionReset = 0;
 
-static RP2040Encoders g_encoders;
+// Error counts already reported by checkErrorLeft() and checkErrorRight().
+static uint32_t g_leftErrorsChecked = 0;
+static uint32_t g_rightErrorsChecked = 0;
+
+// Hardware spin lock that protects the reset counts so that the counts can be read and reset from either core or from
+// an interrupt handler.
+static spin_lock_t * g_resetLock = NULL;
+
+// Both encoders are decoded by a single PIO state machine. The right encoder is on the lower pins.
+static const int32_t g_rightIndex = 0;
+static const int32_t g_leftIndex = 1;
+
+static RP2040DualEncoders g_encoders;
+
+// The latest edges seen by getVelocityLeft() or getVelocityRight() for one of the encoders.
+struct VelocityEstimate
+{
+  // Number of edges in a full cycle of the two encoder signals.
+  static const uint8_t historySize = 4;
+
+  // Counts and PIO cycle timestamps of the latest edges seen by each call, newest first.
+  int32_t counts[historySize];
+  uint32_t cycles[historySize];
+  uint8_t size;
+  // Time that the newest edge was first seen, from time_us_32().
+  uint32_t edgeSeenTime;
+  // Latest speed in counts per second, not flipped, in fixed-point with velocityShift fractional bits.
+  int32_t velocity;
+};
+
+// The speeds are kept in fixed-point so that they can be updated in an interrupt handler without floating point.
+// 8 fractional bits resolve speeds far below a count per second and leave room for millions of counts per second.
+static const uint32_t velocityShift = 8;
+static const int32_t velocityOne = 1 << velocityShift;
+
+static VelocityEstimate g_leftVelocity;
+static VelocityEstimate g_rightVelocity;
+
+// The speed is reported as 0 once there has been no edge for this long, in microseconds. This is also well within
+// the time that the PIO edge timestamps can cover between pin changes.
+static const uint32_t maxEdgeInterval = 500000;
 
 
 void Encoders::init2()
 {
-    // Load the PIO program.
-    bool result = g_encoders.init();
-    assert ( result );
+    static_assert ( leftEncoderAPin == rightEncoderAPin + 4, "The encoder pins don't fit RP2040DualEncoders" );
 
     // Enable pull-ups on the encoder pins.
     gpio_set_pulls(rightEncoderAPin, true, false);
@@ -32,10 +75,11 @@ void Encoders::init2()
     gpio_set_pulls(leftEncoderAPin, true, false);
     gpio_set_pulls(leftEncoderAPin+1, true, false);
 
-    // Configure a PIO state machine for left and right encoders.
-    g_rightIndex = g_encoders.addQuadratureEncoder(rightEncoderAPin);
-    g_leftIndex = g_encoders.addQuadratureEncoder(leftEncoderAPin);
-    assert ( g_rightIndex >= 0 && g_leftIndex >= 0 );
+    // Load the PIO program and start decoding both encoders with one state machine.
+    bool result = g_encoders.init(rightEncoderAPin);
+    assert ( result );
+
+    g_resetLock = spin_lock_init(spin_lock_claim_unused(true));
 }
 
 void Encoders::flipEncoders(bool f)
@@ -43,40 +87,244 @@ void Encoders::flipEncoders(bool f)
   g_flip = f;
 }
 
+// Reads both encoders at the same instant and applies the given resets, optionally resetting them too.
+static void readPositions(int64_t & left, int64_t & right, int64_t & leftReset, int64_t & rightReset,
+                          bool resetLeft, bool resetRight)
+{
+  Encoders::init();
+
+  int64_t currLeft, currRight;
+  uint32_t lockState = spin_lock_blocking(g_resetLock);
+  g_encoders.getPositions(currRight, currLeft);
+  left = currLeft - leftReset;
+  right = currRight - rightReset;
+  if (resetLeft)
+  {
+    leftReset = currLeft;
+  }
+  if (resetRight)
+  {
+    rightReset = currRight;
+  }
+  spin_unlock(g_resetLock, lockState);
+
+  if (g_flip)
+  {
+    left = -left;
+    right = -right;
+  }
+}
+
+static void readCounts(int32_t & left, int32_t & right, bool resetLeft, bool resetRight)
+{
+  int64_t leftPosition, rightPosition;
+  readPositions(leftPosition, rightPosition, g_leftReset, g_rightReset, resetLeft, resetRight);
+  left = (int32_t)leftPosition;
+  right = (int32_t)rightPosition;
+}
+
 int32_t Encoders::getCountsLeft()
+{
+  int32_t left, right;
+  readCounts(left, right, false, false);
+  return left;
+}
+
+int32_t Encoders::getCountsRight()
+{
+  int32_t left, right;
+  readCounts(left, right, false, false);
+  return right;
+}
+
+int32_t Encoders::getCountsAndResetLeft()
+{
+  int32_t left, right;
+  readCounts(left, right, true, false);
+  return left;
+}
+
+int32_t Encoders::getCountsAndResetRight()
+{
+  int32_t left, right;
+  readCounts(left, right, false, true);
+  return right;
+}
+
+void Encoders::getCounts(int32_t & left, int32_t & right)
+{
+  readCounts(left, right, false, false);
+}
+
+void Encoders::getCountsAndReset(int32_t & left, int32_t & right)
+{
+  readCounts(left, right, true, true);
+}
+
+int64_t Encoders::getPositionLeft()
+{
+  int64_t left, right;
+  readPositions(left, right, g_leftPositionReset, g_rightPositionReset, false, false);
+  return left;
+}
+
+int64_t Encoders::getPositionRight()
+{
+  int64_t left, right;
+  readPositions(left, right, g_leftPositionReset, g_rightPositionReset, false, false);
+  return right;
+}
+
+void Encoders::getPositions(int64_t & left, int64_t & right)
+{
+  readPositions(left, right, g_leftPositionReset, g_rightPositionReset, false, false);
+}
+
+void Encoders::getPositionsAndReset(int64_t & left, int64_t & right)
+{
+  readPositions(left, right, g_leftPositionReset, g_rightPositionReset, true, true);
+}
+
+// Returns the speed in counts per second, with velocityShift fractional bits.
+static int32_t updateVelocity(int32_t index, VelocityEstimate & e)
+{
+  int32_t count;
+  uint32_t cycles;
+  g_encoders.getLatestEdge(index, count, cycles);
+  uint32_t now = time_us_32();
+
+  if (e.size == 0)
+  {
+    e.counts[0] = count;
+    e.cycles[0] = cycles;
+    e.size = 1;
+    e.edgeSeenTime = now;
+    e.velocity = 0;
+    return 0;
+  }
+
+  if (count == e.counts[0] && cycles == e.cycles[0])
+  {
+    // No new edge, so the next one is at least as far away as the time since the last one.
+    uint32_t elapsed = now - e.edgeSeenTime;
+    if (elapsed >= maxEdgeInterval)
+    {
+      e.velocity = 0;
+    }
+    else if ((uint64_t)elapsed * abs(e.velocity) > 1000000ULL * velocityOne)
+    {
+      int32_t velocity = (int32_t)(1000000ULL * velocityOne / elapsed);
+      e.velocity = (e.velocity > 0) ? velocity : -velocity;
+    }
+    return e.velocity;
+  }
+
+  uint32_t elapsed = now - e.edgeSeenTime;
+  e.edgeSeenTime = now;
+
+  // The times of edges on either side of a change of direction don't say anything useful about the speed, so
+  // start over from this edge. Also start over after a long gap since the PIO timestamps can't span it reliably.
+  int32_t delta = count - e.counts[0];
+  bool reversed = (delta == 0) ||
+    (e.size > 1 && ((delta > 0) != (e.counts[0] - e.counts[1] > 0)));
+  if (reversed || elapsed >= maxEdgeInterval)
+  {
+    e.counts[0] = count;
+    e.cycles[0] = cycles;
+    e.size = 1;
+    e.velocity = 0;
+    return 0;
+  }
+
+  for (uint8_t i = VelocityEstimate::historySize - 1; i > 0; i--)
+  {
+    e.counts[i] = e.counts[i - 1];
+    e.cycles[i] = e.cycles[i - 1];
+  }
+  e.counts[0] = count;
+  e.cycles[0] = cycles;
+  if (e.size < VelocityEstimate::historySize)
+  {
+    e.size++;
+  }
+
+  // Measure over at least a full cycle of the encoder signals if the edges seen so far allow it.
+  uint8_t ref = e.size - 1;
+  for (uint8_t i = 1; i < e.size; i++)
+  {
+    if (abs(count - e.counts[i]) >= VelocityEstimate::historySize)
+    {
+      ref = i;
+      break;
+    }
+  }
+
+  int32_t edges = count - e.counts[ref];
+  uint32_t interval = cycles - e.cycles[ref];
+  e.velocity = (int32_t)((int64_t)edges * clock_get_hz(clk_sys) * velocityOne / interval);
+  return e.velocity;
+}
+
+float Encoders::getVelocityLeft()
 {
   init();
 
-  int32_t count = g_encoders.getCount(g_leftIndex) - g_leftReset;
-  return g_flip ? -count : count;
+  float velocity = (float)updateVelocity(g_leftIndex, g_leftVelocity) / velocityOne;
+  return g_flip ? -velocity : velocity;
 }
 
-int32_t Encoders::getCountsRight()
+float Encoders::getVelocityRight()
 {
   init();
 
-  int32_t count = g_encoders.getCount(g_rightIndex) - g_rightReset;
-  return g_flip ? -count : count;
+  float velocity = (float)updateVelocity(g_rightIndex, g_rightVelocity) / velocityOne;
+  return g_flip ? -velocity : velocity;
 }
 
-int32_t Encoders::getCountsAndResetLeft()
+int32_t Encoders::getCountsPerSecondLeft()
 {
   init();
 
-  int32_t curr = g_encoders.getCount(g_leftIndex);
-  int32_t count = curr - g_leftReset;
-  g_leftReset = curr;
-  return g_flip ? -count : count;
+  int32_t velocity = updateVelocity(g_leftIndex, g_leftVelocity) / velocityOne;
+  return g_flip ? -velocity : velocity;
 }
 
-int32_t Encoders::getCountsAndResetRight()
+int32_t Encoders::getCountsPerSecondRight()
+{
+  init();
+
+  int32_t velocity = updateVelocity(g_rightIndex, g_rightVelocity) / velocityOne;
+  return g_flip ? -velocity : velocity;
+}
+
+uint32_t Encoders::getErrorCountLeft()
+{
+  init();
+
+  return g_encoders.getIllegalTransitions(g_leftIndex) + g_encoders.getEventOverruns();
+}
+
+uint32_t Encoders::getErrorCountRight()
 {
   init();
 
-  int32_t curr = g_encoders.getCount(g_rightIndex);
-  int32_t count = curr - g_rightReset;
-  g_rightReset = curr;
-  return g_flip ? -count : count;
+  return g_encoders.getIllegalTransitions(g_rightIndex) + g_encoders.getEventOverruns();
+}
+
+bool Encoders::checkErrorLeft()
+{
+  uint32_t errors = getErrorCountLeft();
+  bool error = (errors != g_leftErrorsChecked);
+  g_leftErrorsChecked = errors;
+  return error;
+}
+
+bool Encoders::checkErrorRight()
+{
+  uint32_t errors = getErrorCountRight();
+  bool error = (errors != g_rightErrorsChecked);
+  g_rightErrorsChecked = errors;
+  return error;
 }
 
 }
@@ -16,11 +16,20 @@ namespace Pololu3piPlus2040
 ///
 /// The encoders are monitored in the background using the RP2040's PIO and
 /// DMA peripherals, so your code can perform other tasks without missing
-/// encoder counts.
+/// encoder counts. A single PIO state machine watches both encoders and
+/// records the time of each change in their signals, which lets
+/// getVelocityLeft() and getVelocityRight() measure the speed of the motors
+/// accurately even when they are turning slowly. The changes are buffered
+/// in RAM and a DMA interrupt on the core that first uses the encoders turns
+/// each one into counts as soon as it arrives. Reading the counts just
+/// loads the latest ones that the interrupt published. The buffer holds 256
+/// changes, so interrupts on that core shouldn't be disabled for more than
+/// a few milliseconds while the motors are running at full speed.
 class Encoders
 {
 private:
-    // Each pair of encoder pins must be consecutive pin numbers to work in the PIO.
+    // Each pair of encoder pins must be consecutive pin numbers and the left pair must be 4 pins above the right pair
+    // to work in the PIO.
     static const uint32_t rightEncoderAPin = 8;
     static const uint32_t leftEncoderAPin = 12;
 
@@ -83,6 +92,154 @@ public:
     /// \sa getCountsAndResetLeft()
     static int32_t getCountsAndResetRight();
 
+    /// \brief Gets the counts from both encoders at the same instant.
+    ///
+    /// \param left Set to the count from the left-side encoder, like
+    /// getCountsLeft().
+    /// \param right Set to the count from the right-side encoder, like
+    /// getCountsRight().
+    ///
+    /// Calling getCountsLeft() and getCountsRight() one after the other
+    /// reads the encoders at slightly different times, which can make them
+    /// disagree by a count at high speeds. This function reads both of them
+    /// together instead, which is better for odometry.
+    ///
+    /// This function and all of the other count functions in this class can
+    /// be called from either core or from an interrupt handler once the
+    /// encoders have been initialized. They never decode the encoder changes
+    /// themselves, but they briefly take a hardware spin lock while applying
+    /// the resets, so that resets from different places don't interfere with
+    /// each other.
+    static void getCounts(int32_t & left, int32_t & right);
+
+    /// \brief Gets the counts from both encoders at the same instant and
+    /// clears them.
+    ///
+    /// This function is just like getCounts() except it also clears both
+    /// counts before returning, without missing any counts that arrive in
+    /// between.
+    static void getCountsAndReset(int32_t & left, int32_t & right);
+
+    /// \brief Returns the position of the left-side encoder as a 64-bit
+    /// count.
+    ///
+    /// This is the same as getCountsLeft() except that the count is
+    /// accumulated in 64 bits, so it will not overflow even after years of
+    /// driving. This makes it suitable for odometry that is never reset.
+    /// The position is only reset by getPositionsAndReset(), so resetting
+    /// the counts with getCountsAndResetLeft() or getCountsAndReset() doesn't
+    /// affect it.
+    static int64_t getPositionLeft();
+
+    /// \brief Returns the position of the right-side encoder as a 64-bit
+    /// count.
+    ///
+    /// \sa getPositionLeft()
+    static int64_t getPositionRight();
+
+    /// \brief Gets the positions of both encoders at the same instant.
+    ///
+    /// This is the 64-bit equivalent of getCounts().
+    static void getPositions(int64_t & left, int64_t & right);
+
+    /// \brief Gets the positions of both encoders at the same instant and
+    /// clears them.
+    ///
+    /// This is the 64-bit equivalent of getCountsAndReset(), but it only
+    /// resets the positions and leaves the counts alone. Like the other
+    /// resets, it is done while holding the same lock as the reads, and both
+    /// positions come from the same update by the DMA interrupt, so no counts
+    /// are lost or counted twice.
+    static void getPositionsAndReset(int64_t & left, int64_t & right);
+
+    /// \brief Returns the speed of the left-side encoder in counts per
+    /// second.
+    ///
+    /// Positive values correspond to forward movement of the left side of the
+    /// 3pi+, like the counts returned by getCountsLeft().
+    ///
+    /// The speed is worked out from the latest encoder edges and the times
+    /// that the PIO saw them, which it measures to within about 60 ns.
+    /// Unlike differencing the counts at fixed intervals, this doesn't suffer
+    /// from quantization error at low speeds:
+    ///
+    /// - When the motor is turning slowly, each call normally sees at most
+    ///   one new edge, so the speed comes from the time that the last four
+    ///   edges took.  Four edges make up a full cycle of the encoder's two
+    ///   signals, which cancels out any unevenness in their spacing.
+    /// - When the motor is turning quickly, the speed comes from the number
+    ///   of edges since an earlier call divided by the time between the
+    ///   first and last of those edges.
+    ///
+    /// If no edge has been seen for longer than the speed would suggest, the
+    /// speed is reduced to what it would be if an edge were seen right now,
+    /// so it drops smoothly when the motor stops. It is 0 after a change of
+    /// direction until the next edge, and once no edge has been seen for
+    /// half a second.
+    ///
+    /// Call this regularly (for example once per control loop iteration),
+    /// and from only one core, because each call uses the edges seen since
+    /// the previous one.
+    static float getVelocityLeft();
+
+    /// \brief Returns the speed of the right-side encoder in counts per
+    /// second.
+    ///
+    /// \sa getVelocityLeft()
+    static float getVelocityRight();
+
+    /// \brief Returns the speed of the left-side encoder in whole counts per
+    /// second.
+    ///
+    /// This is the same as getVelocityLeft(), truncated toward zero, but it
+    /// is calculated entirely with integers, so it is the better choice in
+    /// interrupt handlers and other code that shouldn't use floating point.
+    /// It shares its edge history with getVelocityLeft(), so only call one of
+    /// them.
+    static int32_t getCountsPerSecondLeft();
+
+    /// \brief Returns the speed of the right-side encoder in whole counts
+    /// per second.
+    ///
+    /// \sa getCountsPerSecondLeft()
+    static int32_t getCountsPerSecondRight();
+
+    /// \brief Returns true if an error was detected on the left-side
+    /// encoder.
+    ///
+    /// This function resets the error flag automatically, so it will only
+    /// return true if an error was detected since the last time
+    /// checkErrorLeft() was called.
+    ///
+    /// If an error happens, it means that both of the encoder outputs changed
+    /// at the same time from the perspective of the PIO, so it was unable to
+    /// tell what direction the motor was moving, and the encoder count could
+    /// be inaccurate. The most likely causes are electrical noise on the
+    /// encoder signals or interrupts being disabled for long enough that the
+    /// buffered encoder changes were overwritten before they were decoded.
+    /// Overwritten changes are reported as an error on both encoders.
+    static bool checkErrorLeft();
+
+    /// \brief Returns true if an error was detected on the right-side
+    /// encoder.
+    ///
+    /// \sa checkErrorLeft()
+    static bool checkErrorRight();
+
+    /// \brief Returns the number of errors that have been detected on the
+    /// left-side encoder.
+    ///
+    /// This counts the same errors as checkErrorLeft() but is never reset,
+    /// which makes it easier to tell how often counts are being missed, for
+    /// example by logging it alongside the counts during a run.
+    static uint32_t getErrorCountLeft();
+
+    /// \brief Returns the number of errors that have been detected on the
+    /// right-side encoder.
+    ///
+    /// \sa getErrorCountLeft()
+    static uint32_t getErrorCountRight();
+
 private:
 
     static void init2();
@@ -1,6 +1,8 @@
 // Copyright (C) Pololu Corporation.  See www.pololu.com for details.
 
 #include "Pololu3piPlus2040IMU.h"
+#include "Pololu3piPlus2040Calibration.h"
+#include "Pololu3piPlus2040RobotFrame.h"
 
 #define LSM6DSO_WHO_ID 0x6C
 #define LIS3MDL_WHO_ID 0x3D
@@ -126,6 +128,54 @@ void IMU::configureForCompassHeading()
   }
 }
 
+uint8_t IMU::readGyroConfig()
+{
+  switch (type)
+  {
+  case IMUType::LSM6DSO_LIS3MDL:
+  {
+    uint8_t config = readReg(LSM6DSO_ADDR, LSM6DSO_REG_CTRL2_G);
+    return lastError ? 0 : config;
+  }
+  default:
+    return 0;
+  }
+}
+
+bool IMU::saveGyroOffset(int16_t offset)
+{
+  uint8_t gyroConfig = readGyroConfig();
+  if (gyroConfig == 0)
+  {
+    return false;
+  }
+
+  CalibrationRecord record;
+  CalibrationStorage::load(record);
+
+  record.gyroOffset = offset;
+  record.gyroType = (uint8_t)type;
+  record.gyroConfig = gyroConfig;
+  record.valid |= CalibrationRecord::GYRO_VALID;
+
+  return CalibrationStorage::save(record);
+}
+
+bool IMU::loadGyroOffset(int16_t & offset)
+{
+  CalibrationRecord record;
+  if (!CalibrationStorage::load(record) ||
+      !(record.valid & CalibrationRecord::GYRO_VALID) ||
+      record.gyroType != (uint8_t)type ||
+      record.gyroConfig != readGyroConfig())
+  {
+    return false;
+  }
+
+  offset = record.gyroOffset;
+  return true;
+}
+
 // Reads the 3 accelerometer channels and stores them in vector a
 void IMU::readAcc(void)
 {
@@ -179,6 +229,13 @@ void IMU::read()
   readMag();
 }
 
+void IMU::read(const RobotFrame & frame)
+{
+  a = frame.a;
+  g = frame.g;
+  m = frame.m;
+}
+
 bool IMU::accDataReady()
 {
   switch (type)
@@ -37,6 +37,8 @@
 namespace Pololu3piPlus2040
 {
 
+struct RobotFrame;
+
 /// \brief The type of the inertial sensors.
 enum class IMUType : uint8_t {
   /// Unknown or unrecognized
@@ -102,6 +104,33 @@ public:
   /// compass heading with the magnetometer.
   void configureForCompassHeading();
 
+  /// \brief Saves a gyro offset to flash.
+  ///
+  /// \param offset The average gyro Z axis reading while the robot is still,
+  /// as calculated by the turn sensing code in the examples.
+  ///
+  /// \return True if the offset was saved successfully. False if it wasn't,
+  /// including if the gyro settings couldn't be read because init() hasn't
+  /// succeeded.
+  ///
+  /// The sensor type and the gyro's current output data rate and full scale
+  /// are saved with the offset, since the offset is only valid for those
+  /// settings. Any saved line or bump sensor calibration is kept. This takes
+  /// about 50 ms so call it once after calibrating.
+  bool saveGyroOffset(int16_t offset);
+
+  /// \brief Loads a gyro offset saved with saveGyroOffset().
+  ///
+  /// \param offset Receives the saved offset. It is left unchanged if no
+  /// offset was saved.
+  ///
+  /// \return True if the offset was loaded; false otherwise.
+  ///
+  /// The offset is only loaded if it was saved with the same sensor type and
+  /// gyro settings that are in use now, so call this after init() and after
+  /// configuring the gyro, for example with configureForTurnSensing().
+  bool loadGyroOffset(int16_t & offset);
+
   /// \brief Writes an 8-bit sensor register.
   ///
   /// \param addr Device address.
@@ -154,6 +183,13 @@ public:
   /// vectors.
   void read();
 
+  /// \brief Makes the measurements from a RobotFrame available in the #a,
+  /// #g, and #m vectors instead of reading the sensors.
+  ///
+  /// \param frame A frame from readRobotFrame() or
+  /// SensorService::getLatestFrame().
+  void read(const RobotFrame & frame);
+
   /// \brief Indicates whether the accelerometer has new measurement data ready.
   ///
   /// \return True if there is new accelerometer data available; false
@@ -175,6 +211,10 @@ private:
   uint8_t lastError = 0;
   IMUType type = IMUType::Unknown;
 
+  // Returns the gyro's output data rate and full scale setting, or 0 if it
+  // couldn't be read.
+  uint8_t readGyroConfig();
+
   int16_t testReg(uint8_t addr, uint8_t reg)
   {
     Wire.beginTransmission(addr);
@@ -0,0 +1,116 @@
+// Copyright (C) Pololu Corporation.  See www.pololu.com for details.
+
+#include "Pololu3piPlus2040LightSensors.h"
+#include "Pololu3piPlus2040RobotFrame.h"
+
+namespace Pololu3piPlus2040
+{
+
+void LightSensors::read(LineSensorsReadMode lineMode)
+{
+  // Complete any read that was previously started with beginRead() before starting this one.
+  finishRead();
+
+  // The line or bump sensors can have their own read pending on the shared QTR. Finish it for them and give them
+  // back their results after this read. beginRead() sets both emitters for this read.
+  QTRSensorReadings otherReadings;
+  bool otherReadPending = pQTR->takePendingRead(otherReadings);
+
+  if (beginRead(lineMode))
+  {
+    finishRead();
+  }
+
+  if (otherReadPending)
+  {
+    pQTR->holdReadings(otherReadings);
+  }
+}
+
+bool LightSensors::read(const RobotFrame& frame)
+{
+  // Don't leave a read started with beginRead() hanging.
+  finishRead();
+
+  if (frame.lightReadCount == readCount)
+  {
+    return false;
+  }
+  readings = frame.lightReadings;
+  lineMode = frame.lineMode;
+  readCount = frame.lightReadCount;
+  return true;
+}
+
+bool LightSensors::beginRead(LineSensorsReadMode lineMode)
+{
+  // The QTR state machine is shared with the line and bump sensors so only one read can be in progress at a time.
+  if (readPending || pQTR->isReadPending())
+  {
+    return false;
+  }
+
+  // Pin 26 is shared with the analog battery voltage so use init() to make sure that the SIO function has been
+  // reselected for the pin. This matches LineSensors::emittersOn() and emittersOff().
+  switch (lineMode)
+  {
+    case LineSensorsReadMode::Off:
+      lineEmitterPin.init(false, false, false, false);
+      break;
+
+    case LineSensorsReadMode::Manual:
+      break;
+
+    case LineSensorsReadMode::On:
+      lineEmitterPin.init(true, true, false, false);
+      break;
+
+    default: // invalid or OnAndOff - do nothing
+      return false;
+  }
+
+  // The bump sensor emitters are always on so that the same reading can be used by BumpSensors.
+  bumpEmitterPin.setOutputHigh();
+  pQTR->startRead(QTRSensors::ALL_SENSORS_MASK);
+  pendingLineMode = lineMode;
+  readPending = true;
+  return true;
+}
+
+bool LightSensors::isReadComplete()
+{
+  if (!readPending)
+  {
+    return true;
+  }
+  if (!pQTR->isReadComplete())
+  {
+    return false;
+  }
+
+  // Turn the emitters off as soon as the discharge has been timed instead of waiting for finishRead().
+  bumpEmitterPin.setInput();
+  if (pendingLineMode == LineSensorsReadMode::On)
+  {
+    lineEmitterPin.init(false, false, false, false);
+  }
+  return true;
+}
+
+void LightSensors::finishRead()
+{
+  if (!readPending)
+  {
+    return;
+  }
+
+  while (!isReadComplete())
+  {
+  }
+  readings = pQTR->finishRead();
+  lineMode = pendingLineMode;
+  readCount++;
+  readPending = false;
+}
+
+}
@@ -0,0 +1,133 @@
+// Copyright (C) Pololu Corporation.  See www.pololu.com for details.
+
+/// \file Pololu3piPlus2040LightSensors.h
+
+#pragma once
+
+#include <Arduino.h>
+#include "RP2040SIO.h"
+#include "RP2040QTR.h"
+#include "Pololu3piPlus2040LineSensors.h"
+
+namespace Pololu3piPlus2040
+{
+
+struct RobotFrame;
+
+/// \brief Reads the two bump sensors and the five line sensors at the same
+/// time so that one reading can be shared by BumpSensors and LineSensors.
+///
+/// The bump sensors and line sensors are all timed by the same RP2040 PIO
+/// state machine so BumpSensors::read() and LineSensors::read() each take a
+/// full reading of their own. A program which checks the bump sensors while
+/// following a line can instead call read() on this class once per loop and
+/// pass the object to the BumpSensors and LineSensors methods which accept a
+/// LightSensors object. They then use the most recent reading rather than
+/// reading the sensors again.
+///
+/// Both sets of emitters are on during a shared read, so each set of
+/// sensors sees a little light from the other set's emitters that it
+/// doesn't see when it is read on its own. Calibrate them with
+/// LineSensors::calibrate(LightSensors&) and
+/// BumpSensors::calibrate(LightSensors&), using the same line emitter mode
+/// as the shared reads, whenever the readings will come from this class or
+/// from a RobotFrame. Calibration from LineSensors::calibrate() and
+/// BumpSensors::calibrate() goes with their own read methods.
+///
+/// Example usage:
+/// ~~~{.cpp}
+/// lineSensors.calibrate(lightSensors);
+/// bumpSensors.calibrate(lightSensors);
+///
+/// lightSensors.read();
+/// uint8_t bumped = bumpSensors.read(lightSensors);
+/// uint16_t position = lineSensors.readLineBlack(lightSensors);
+/// ~~~
+class LightSensors
+{
+  private:
+    RP2040SIO::Pin<23> bumpEmitterPin;
+    RP2040SIO::Pin<26> lineEmitterPin;
+
+  public:
+    LightSensors()
+    {
+      pQTR = QTRSensors::getSharedQTR();
+      memset(&readings, 0, sizeof(readings));
+    }
+
+    /// \brief Reads all of the bump and line sensors.
+    ///
+    /// \param lineMode The behavior of the line sensor emitters during the
+    /// read, as a member of the ::LineSensorsReadMode enum. The default is
+    /// LineSensorsReadMode::On. The bump sensor emitters are always turned on
+    /// for the read. LineSensorsReadMode::OnAndOff is not supported.
+    void read(LineSensorsReadMode lineMode = LineSensorsReadMode::On);
+
+    /// \brief Starts reading all of the bump and line sensors in the
+    /// background.
+    ///
+    /// \param lineMode The behavior of the line sensor emitters during the
+    /// read, as a member of the ::LineSensorsReadMode enum.
+    ///
+    /// \return True if the read was started; false if a read of the sensors is
+    /// already in progress.
+    ///
+    /// Works like LineSensors::beginRead(). Call isReadComplete() to check
+    /// whether the read is done and finishRead() to store the results in this
+    /// object.
+    bool beginRead(LineSensorsReadMode lineMode = LineSensorsReadMode::On);
+
+    /// \brief Takes the readings from a RobotFrame instead of reading the
+    /// sensors.
+    ///
+    /// \param frame A frame from readRobotFrame() or
+    /// SensorService::getLatestFrame().
+    ///
+    /// \return True if the frame holds a newer reading than this object did;
+    /// false otherwise.
+    bool read(const RobotFrame& frame);
+
+    /// \brief Indicates whether the read started by beginRead() has completed.
+    ///
+    /// \return True if the results are ready to be collected with
+    /// finishRead(); false otherwise. This method never blocks.
+    bool isReadComplete();
+
+    /// \brief Finishes the read started by beginRead().
+    ///
+    /// This method waits for the read to complete if isReadComplete() hasn't
+    /// returned true yet.
+    void finishRead();
+
+    /// \brief Returns the raw readings from the most recent read.
+    const QTRSensorReadings& getReadings() const { return readings; }
+
+    /// \brief Returns the line sensor emitter behavior used for the most
+    /// recent read.
+    LineSensorsReadMode getLineMode() const { return lineMode; }
+
+    /// \brief Returns the number of reads that have completed.
+    ///
+    /// This can be used to tell whether a new reading has been taken since the
+    /// last time it was checked.
+    uint32_t getReadCount() const { return readCount; }
+
+  private:
+    /// Pointer to the QTR sensor reading singleton shared with the line and
+    /// bump sensors.
+    QTRSensors* pQTR;
+
+    /// Raw readings from the most recent read.
+    QTRSensorReadings readings;
+    /// Line emitter mode of the most recent read.
+    LineSensorsReadMode lineMode = LineSensorsReadMode::On;
+    /// Line emitter mode of the read started by beginRead().
+    LineSensorsReadMode pendingLineMode = LineSensorsReadMode::On;
+    /// Has beginRead() started a read that hasn't been finished yet?
+    bool readPending = false;
+    /// Number of reads that have completed.
+    uint32_t readCount = 0;
+};
+
+}
@@ -1,14 +1,64 @@
 // Copyright (C) Pololu Corporation.  See www.pololu.com for details.
 
 #include "Pololu3piPlus2040LineSensors.h"
+#include "Pololu3piPlus2040LightSensors.h"
 
 namespace Pololu3piPlus2040
 {
 
 void LineSensors::resetCalibration()
 {
-  calibrationOn.init();
-  calibrationOff.init();
+  calibrationOn.init(pQTR->getMaxReading());
+  calibrationOff.init(pQTR->getMaxReading());
+}
+
+bool LineSensors::saveCalibration()
+{
+  CalibrationRecord record;
+  CalibrationStorage::load(record);
+
+  record.valid &= ~(CalibrationRecord::LINE_ON_VALID | CalibrationRecord::LINE_OFF_VALID);
+  record.lineMaxReading = pQTR->getMaxReading();
+  if (calibrationOn.initialized)
+  {
+    record.lineOnMinimum = calibrationOn.minimum;
+    record.lineOnMaximum = calibrationOn.maximum;
+    record.valid |= CalibrationRecord::LINE_ON_VALID;
+  }
+  if (calibrationOff.initialized)
+  {
+    record.lineOffMinimum = calibrationOff.minimum;
+    record.lineOffMaximum = calibrationOff.maximum;
+    record.valid |= CalibrationRecord::LINE_OFF_VALID;
+  }
+
+  return CalibrationStorage::save(record);
+}
+
+bool LineSensors::loadCalibration()
+{
+  CalibrationRecord record;
+  if (!CalibrationStorage::load(record) || record.lineMaxReading != pQTR->getMaxReading())
+  {
+    return false;
+  }
+
+  if (record.valid & CalibrationRecord::LINE_ON_VALID)
+  {
+    calibrationOn.minimum = record.lineOnMinimum;
+    calibrationOn.maximum = record.lineOnMaximum;
+    calibrationOn.updateScales();
+    calibrationOn.initialized = true;
+  }
+  if (record.valid & CalibrationRecord::LINE_OFF_VALID)
+  {
+    calibrationOff.minimum = record.lineOffMinimum;
+    calibrationOff.maximum = record.lineOffMaximum;
+    calibrationOff.updateScales();
+    calibrationOff.initialized = true;
+  }
+
+  return (record.valid & (CalibrationRecord::LINE_ON_VALID | CalibrationRecord::LINE_OFF_VALID)) != 0;
 }
 
 void LineSensors::calibrate(LineSensorsReadMode mode)
@@ -17,6 +67,8 @@ void LineSensors::calibrate(LineSensorsReadMode mode)
   {
     case LineSensorsReadMode::On:
       return calibrateOnOrOff(calibrationOn, LineSensorsReadMode::On);
+    case LineSensorsReadMode::OnAndOff:
+      return calibrateOnOrOff(calibrationOn, LineSensorsReadMode::OnAndOff);
     case LineSensorsReadMode::Off:
       return calibrateOnOrOff(calibrationOff, LineSensorsReadMode::Off);
     default:
@@ -25,17 +77,49 @@ void LineSensors::calibrate(LineSensorsReadMode mode)
   }
 }
 
-void LineSensors::calibrateOnOrOff(CalibrationData & calibration, LineSensorsReadMode mode)
+void LineSensors::calibrate(LightSensors & lightSensors, LineSensorsReadMode mode)
+{
+  switch (mode)
+  {
+    case LineSensorsReadMode::On:
+      return calibrateOnOrOff(calibrationOn, LineSensorsReadMode::On, &lightSensors);
+    case LineSensorsReadMode::Off:
+      return calibrateOnOrOff(calibrationOff, LineSensorsReadMode::Off, &lightSensors);
+    default:
+      // LightSensors doesn't support OnAndOff or manual emitter control
+      return;
+  }
+}
+
+void LineSensors::calibrateOnOrOff(CalibrationData & calibration, LineSensorsReadMode mode,
+                                   LightSensors * pLightSensors)
 {
   LineSensorReadings maxSensorValues;
   LineSensorReadings minSensorValues;
 
+  // (Re)initialize the calibration values for the current timeout if necessary.
+  if (!calibration.initialized)
+  {
+    calibration.init(pQTR->getMaxReading());
+  }
+
   for (uint8_t j = 0; j < 10; j++)
   {
-    read(mode);
+    if (pLightSensors)
+    {
+      pLightSensors->read(mode);
+      read(*pLightSensors);
+    }
+    else
+    {
+      read(mode);
+    }
 
     for (uint8_t i = 0; i < _sensorCount; i++)
     {
+      // sensors which aren't being read don't have anything to contribute
+      if (!(_activeSensors & (1 << i))) { continue; }
+
       // set the max we found THIS time
       if (j == 0 || rawSensorValues[i] > maxSensorValues.vals[i])
       {
@@ -53,6 +137,8 @@ void LineSensors::calibrateOnOrOff(CalibrationData & calibration, LineSensorsRea
   // record the min and max calibration values
   for (uint8_t i = 0; i < _sensorCount; i++)
   {
+    if (!(_activeSensors & (1 << i))) { continue; }
+
     // Update maximum only if the min of 10 readings was still higher than it
     // (we got 10 readings in a row higher than the existing maximum).
     if (minSensorValues.vals[i] > calibration.maximum.vals[i])
@@ -67,6 +153,64 @@ void LineSensors::calibrateOnOrOff(CalibrationData & calibration, LineSensorsRea
       calibration.minimum.vals[i] = maxSensorValues.vals[i];
     }
   }
+  calibration.updateScales();
+  calibration.initialized = true;
+}
+
+void LineSensors::autoCalibrate(CalibrationData& calibration)
+{
+  // Ranges narrower than this haven't seen both the line and the background yet.
+  uint16_t minRange = pQTR->getMaxReading() >> 3;
+
+  // Shrink the ranges a little every 256 reads so that they follow the readings back down if the lighting changes.
+  bool decay = (++_autoCalibrationReads == 0);
+
+  for (uint8_t i = 0; i < _sensorCount; i++)
+  {
+    if (!(_activeSensors & (1 << i))) { continue; }
+
+    uint16_t value = rawSensorValues[i];
+    uint16_t calmin = calibration.minimum.vals[i];
+    uint16_t calmax = calibration.maximum.vals[i];
+
+    if (!calibration.initialized || calmax < calmin)
+    {
+      // start from this reading
+      calmin = value;
+      calmax = value;
+    }
+    else if (calmax - calmin < minRange)
+    {
+      // Not calibrated yet so take in new readings right away.
+      if (value > calmax) { calmax = value; }
+      if (value < calmin) { calmin = value; }
+    }
+    else if (value > calmax)
+    {
+      // Only move 1/8th of the way to readings outside of the range so that a single outlier can't stretch it.
+      calmax += (value - calmax + 7) >> 3;
+    }
+    else if (value < calmin)
+    {
+      calmin -= (calmin - value + 7) >> 3;
+    }
+    else if (decay)
+    {
+      // Pull each end in by 1/32nd of the range without going below the minimum range.
+      uint16_t shrink = (calmax - calmin) >> 5;
+      uint16_t maxShrink = (calmax - calmin - minRange) / 2;
+      if (shrink > maxShrink) { shrink = maxShrink; }
+      calmin += shrink;
+      calmax -= shrink;
+    }
+
+    if (calmin != calibration.minimum.vals[i] || calmax != calibration.maximum.vals[i])
+    {
+      calibration.minimum.vals[i] = calmin;
+      calibration.maximum.vals[i] = calmax;
+      calibration.updateScale(i);
+    }
+  }
   calibration.initialized = true;
 }
 
@@ -75,6 +219,7 @@ void LineSensors::readCalibratedPrivate(LineSensorsReadMode mode)
   switch (mode)
   {
     case LineSensorsReadMode::On:
+    case LineSensorsReadMode::OnAndOff:
         return readCalibratedPrivate(calibrationOn, mode);
     case LineSensorsReadMode::Off:
         return readCalibratedPrivate(calibrationOff, mode);
@@ -86,8 +231,8 @@ void LineSensors::readCalibratedPrivate(LineSensorsReadMode mode)
 
 void LineSensors::readCalibratedPrivate(CalibrationData& calibration, LineSensorsReadMode mode)
 {
-  // if not calibrated, do nothing
-  if (!calibration.initialized)
+  // if not calibrated, do nothing (unless the read will be used to calibrate)
+  if (!calibration.initialized && !_autoCalibration)
   {
     return;
   }
@@ -95,44 +240,86 @@ void LineSensors::readCalibratedPrivate(CalibrationData& calibration, LineSensor
   // read the needed values
   readPrivate(mode);
 
-  for (uint8_t i = 0; i < _sensorCount; i++)
+  calibrateRawValues(calibration);
+}
+
+void LineSensors::calibrateRawValues(LineSensorsReadMode mode)
+{
+  switch (mode)
   {
-    uint16_t calmin = calibration.minimum.vals[i];
-    uint16_t calmax = calibration.maximum.vals[i];
-    uint16_t denominator = calmax - calmin;
-    int16_t  value = 0;
+    case LineSensorsReadMode::On:
+    case LineSensorsReadMode::OnAndOff:
+        return calibrateRawValues(calibrationOn);
+    case LineSensorsReadMode::Off:
+        return calibrateRawValues(calibrationOff);
+    default:
+        // manual emitter control is not supported
+        return;
+  }
+}
 
-    if (denominator != 0)
-    {
-      value = (((int32_t)rawSensorValues[i]) - calmin) * 1000 / denominator;
-    }
+void LineSensors::calibrateRawValues(CalibrationData& calibration)
+{
+  if (_autoCalibration)
+  {
+    autoCalibrate(calibration);
+  }
 
-    if (value < 0)
-    {
-      value = 0;
-    }
-    else if (value > 1000)
-    {
-      value = 1000;
-    }
+  // if not calibrated, do nothing
+  if (!calibration.initialized)
+  {
+    return;
+  }
 
-    calibratedSensorValues[i] = value;
+  for (uint8_t i = 0; i < _sensorCount; i++)
+  {
+    calibratedSensorValues[i] = calibration.calibrateValue(i, rawSensorValues[i]);
   }
 }
 
 uint16_t LineSensors::readLinePrivate(LineSensorsReadMode mode, bool invertReadings)
 {
-  bool onLine = false;
-  uint32_t avg = 0; // this is for the weighted total
-  uint16_t sum = 0; // this is for the denominator, which is <= 64000
-
   // manual emitter control is not supported
   if (mode == LineSensorsReadMode::Manual) { return 0; }
 
   readCalibratedPrivate(mode);
 
+  return calculateLinePosition(invertReadings);
+}
+
+uint16_t LineSensors::readLinePrivate(const LightSensors& lightSensors, bool invertReadings)
+{
+  // manual emitter control is not supported
+  if (lightSensors.getLineMode() == LineSensorsReadMode::Manual) { return 0; }
+
+  readCalibrated(lightSensors);
+
+  return calculateLinePosition(invertReadings);
+}
+
+uint16_t LineSensors::finishReadLinePrivate(bool invertReadings)
+{
+  finishRead();
+
+  // manual emitter control is not supported
+  if (_pendingMode == LineSensorsReadMode::Manual) { return 0; }
+
+  calibrateRawValues(_pendingMode);
+
+  return calculateLinePosition(invertReadings);
+}
+
+uint16_t LineSensors::calculateLinePosition(bool invertReadings)
+{
+  bool onLine = false;
+  uint32_t avg = 0; // this is for the weighted total
+  uint16_t sum = 0; // this is for the denominator, which is <= 64000
+
   for (uint8_t i = 0; i < _sensorCount; i++)
   {
+    // sensors which weren't read would look like a white line when inverted
+    if (!(_activeSensors & (1 << i))) { continue; }
+
     uint16_t value = calibratedSensorValues[i];
     if (invertReadings) { value = 1000 - value; }
 
@@ -165,34 +352,296 @@ uint16_t LineSensors::readLinePrivate(LineSensorsReadMode mode, bool invertReadi
   return _lastPosition;
 }
 
+LineEstimate LineSensors::readLineEstimatePrivate(LineSensorsReadMode mode, bool invertReadings)
+{
+  // manual emitter control is not supported
+  if (mode == LineSensorsReadMode::Manual) { return LineEstimate(); }
+
+  readCalibratedPrivate(mode);
+
+  return estimateLinePosition(invertReadings);
+}
+
+LineEstimate LineSensors::readLineEstimatePrivate(const LightSensors& lightSensors, bool invertReadings)
+{
+  // manual emitter control is not supported
+  if (lightSensors.getLineMode() == LineSensorsReadMode::Manual) { return LineEstimate(); }
+
+  readCalibrated(lightSensors);
+
+  return estimateLinePosition(invertReadings);
+}
+
+LineEstimate LineSensors::finishReadLineEstimatePrivate(bool invertReadings)
+{
+  finishRead();
+
+  // manual emitter control is not supported
+  if (_pendingMode == LineSensorsReadMode::Manual) { return LineEstimate(); }
+
+  calibrateRawValues(_pendingMode);
+
+  return estimateLinePosition(invertReadings);
+}
+
+LineEstimate LineSensors::estimateLinePosition(bool invertReadings)
+{
+  LineEstimate estimate = LineEstimate();
+  int32_t values[_sensorCount];
+  uint8_t peak = 0;
+  uint16_t peakValue = 0;
+  uint16_t minValue = 1000;
+  uint32_t avg = 0; // this is for the weighted total
+  uint16_t sum = 0; // this is for the denominator, which is <= 5000
+  uint8_t activeCount = 0;
+  uint8_t onLineCount = 0;
+
+  for (uint8_t i = 0; i < _sensorCount; i++)
+  {
+    // sensors which weren't read are treated as not seeing the line
+    if (!(_activeSensors & (1 << i)))
+    {
+      values[i] = 0;
+      continue;
+    }
+
+    uint16_t value = calibratedSensorValues[i];
+    if (invertReadings) { value = 1000 - value; }
+    values[i] = value;
+
+    // keep track of the sensor which sees the most line and the contrast
+    if (value > peakValue)
+    {
+      peak = i;
+      peakValue = value;
+    }
+    if (value < minValue) { minValue = value; }
+
+    // count the sensors which are more over the line than not
+    activeCount++;
+    if (value > 500) { onLineCount++; }
+
+    // only average in values that are above a noise threshold
+    if (value > 50)
+    {
+      avg += (uint32_t)value * (i * 1000);
+      sum += value;
+    }
+  }
+  if (activeCount == 0) { return estimate; }
+
+  estimate.confidence = peakValue - minValue;
+
+  // keep track of whether we see the line at all
+  if (peakValue <= 200)
+  {
+    // Report the side it was last seen on, just like readLineBlack().
+    estimate.position = (_lastPosition < (_sensorCount - 1) * 1000 / 2) ? 0 : (_sensorCount - 1) * 1000;
+    return estimate;
+  }
+  estimate.onLine = true;
+  estimate.width = (uint32_t)sum * 1000 / peakValue;
+  estimate.allOnLine = (onLineCount == activeCount);
+
+  // A single line is narrow enough that it can't fully cover more than about two sensors.
+  estimate.intersection = (estimate.width > 3000);
+
+  int32_t position;
+  if (estimate.intersection)
+  {
+    // There is no single peak to fit so fall back to the weighted average.
+    position = avg / sum;
+  }
+  else
+  {
+    // Fit a parabola through the peak and its neighbors and use its vertex. Neighbors off the end of the array
+    // are treated as not seeing the line, so the estimate approaches the edge sensor's position smoothly as the
+    // line moves out past it. Since the peak is at least as large as both neighbors, the curvature is never
+    // positive and the vertex is always within half a sensor of the peak.
+    int32_t left = (peak > 0) ? values[peak - 1] : 0;
+    int32_t right = (peak < _sensorCount - 1) ? values[peak + 1] : 0;
+    int32_t curvature = left - 2 * (int32_t)peakValue + right;
+
+    position = peak * 1000;
+    if (curvature != 0)
+    {
+      position += 500 * (left - right) / curvature;
+    }
+    position = constrain(position, 0, (_sensorCount - 1) * 1000);
+  }
+  estimate.position = position;
+
+  // A reading which is all line has no position information worth remembering.
+  if (!estimate.allOnLine)
+  {
+    _lastPosition = estimate.position;
+  }
+
+  return estimate;
+}
+
 void LineSensors::readPrivate(LineSensorsReadMode mode)
 {
+  // Complete any read that was previously started with beginRead() before starting this one.
+  finishRead();
+
+  // The bump sensors or LightSensors can have their own read pending on the shared QTR. Finish it for them, with
+  // the bump emitters off for this read as they would be if it were done on its own, and give them back their
+  // results afterwards.
+  QTRSensorReadings otherReadings;
+  bool otherReadPending = pQTR->takePendingRead(otherReadings);
+  if (otherReadPending)
+  {
+    bumpEmitterPin.setInput();
+  }
+
+  if (beginRead(mode))
+  {
+    finishRead();
+  }
+
+  if (otherReadPending)
+  {
+    pQTR->holdReadings(otherReadings);
+  }
+}
+
+bool LineSensors::beginRead(LineSensorsReadMode mode)
+{
+  // The QTR state machine is shared with the bump sensors so only one read can be in progress at a time.
+  if (_readPending || pQTR->isReadPending())
+  {
+    return false;
+  }
+
   switch (mode)
   {
     case LineSensorsReadMode::Off:
       emittersOff();
-      readPrivate();
-      return;
+      break;
 
     case LineSensorsReadMode::Manual:
-      readPrivate();
-      return;
+      break;
 
     case LineSensorsReadMode::On:
+    case LineSensorsReadMode::OnAndOff:
       emittersOn();
-      readPrivate();
-      emittersOff();
-      return;
+      break;
 
     default: // invalid - do nothing
-      return;
+      return false;
+  }
+
+  pQTR->startRead(getQTRMask());
+  _pendingMode = mode;
+  _readPending = true;
+  _offPhase = false;
+  return true;
+}
+
+bool LineSensors::isReadComplete()
+{
+  if (!_readPending)
+  {
+    return true;
+  }
+  if (!pQTR->isReadComplete())
+  {
+    return false;
+  }
+
+  // Turn the emitters off as soon as the discharge has been timed instead of waiting for finishRead().
+  if (_pendingMode == LineSensorsReadMode::On || _pendingMode == LineSensorsReadMode::OnAndOff)
+  {
+    emittersOff();
+  }
+
+  // The emitters on reading of an OnAndOff read is done so start the emitters off one. The QTR state machine is
+  // left waiting at the end of the first reading so it starts the second one right away.
+  if (_pendingMode == LineSensorsReadMode::OnAndOff && !_offPhase)
+  {
+    _onReadings = pQTR->finishRead();
+    pQTR->startRead(getQTRMask());
+    _offPhase = true;
+    return false;
   }
+  return true;
 }
 
-void LineSensors::readPrivate()
+void LineSensors::finishRead()
 {
-  QTRSensorReadings readings = pQTR->read();
+  if (!_readPending)
+  {
+    return;
+  }
 
+  while (!isReadComplete())
+  {
+  }
+  if (_pendingMode == LineSensorsReadMode::OnAndOff)
+  {
+    storeOnAndOffValues(pQTR->finishRead());
+  }
+  else
+  {
+    storeRawValues(pQTR->finishRead());
+  }
+  _readPending = false;
+}
+
+void LineSensors::read(const LightSensors& lightSensors)
+{
+  storeRawValues(lightSensors.getReadings());
+}
+
+void LineSensors::readCalibrated(const LightSensors& lightSensors)
+{
+  read(lightSensors);
+  calibrateRawValues(lightSensors.getLineMode());
+}
+
+void LineSensors::finishReadCalibrated()
+{
+  finishRead();
+  calibrateRawValues(_pendingMode);
+}
+
+void LineSensors::storeOnAndOffValues(const QTRSensorReadings& offReadings)
+{
+  uint16_t maxValue = pQTR->getMaxReading();
+  uint8_t qtrMask = getQTRMask();
+  for (uint8_t i = 0; i < LIGHT_SENSOR_COUNT; i++)
+  {
+    if (!(qtrMask & (1 << i))) { continue; }
+
+    uint32_t value = _onReadings.raw[i] + maxValue - offReadings.raw[i];
+    if (value > maxValue)
+    {
+      // This usually doesn't happen, because the sensor reading should
+      // go up when the emitters are turned off.
+      value = maxValue;
+    }
+    _onReadings.raw[i] = value;
+  }
+  storeRawValues(_onReadings);
+}
+
+uint8_t LineSensors::getQTRMask()
+{
+  // Sensor order is reversed in rawSensorValues compared to the QTR readings. See storeRawValues().
+  uint8_t qtrMask = 0;
+  for (uint8_t i = 0; i < _sensorCount; i++)
+  {
+    if (_activeSensors & (1 << i))
+    {
+      qtrMask |= 1 << (BUMP_SENSOR_COUNT + _sensorCount - 1 - i);
+    }
+  }
+  return qtrMask;
+}
+
+void LineSensors::storeRawValues(const QTRSensorReadings& readings)
+{
   // Reverse sensor reading order to match 32U4 version of the robot as it is copied into rawSensorValues array.
   rawSensorValues[0] = readings.lineReadings.vals[4];
   rawSensorValues[1] = readings.lineReadings.vals[3];
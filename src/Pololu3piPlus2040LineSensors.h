@@ -7,10 +7,13 @@
 #include <Arduino.h>
 #include "RP2040SIO.h"
 #include "RP2040QTR.h"
+#include "Pololu3piPlus2040Calibration.h"
 
 namespace Pololu3piPlus2040
 {
 
+class LightSensors;
+
 /// \brief Emitter behavior when taking readings.
 enum class LineSensorsReadMode : uint8_t {
   /// Each reading is made without turning on the infrared (IR) emitters. The
@@ -21,6 +24,16 @@ enum class LineSensorsReadMode : uint8_t {
   /// reflectance.
   On,
 
+  /// For each sensor, a reading is made in both the on and off states. The
+  /// value returned is **on + max &minus; off**, where **on** and **off** are
+  /// the reading with the emitters on and off, respectively, and **max** is
+  /// the maximum possible sensor reading. This mode can reduce the amount of
+  /// interference from uneven ambient lighting. The two readings are taken
+  /// back to back, so a read takes about twice as long as in the On mode.
+  /// Calibration data for this mode is stored in
+  /// LineSensors::calibrationOn.
+  OnAndOff,
+
   /// Calling read() with this mode prevents it from automatically controlling
   /// the emitters: they are left in their existing states, which allows manual
   /// control of the emitters for testing and advanced use. Calibrating and
@@ -28,6 +41,45 @@ enum class LineSensorsReadMode : uint8_t {
   Manual
 };
 
+/// \brief A line position estimate along with information about how well
+/// the sensors could see the line.
+///
+/// Returned by LineSensors::readLineEstimateBlack(),
+/// LineSensors::readLineEstimateWhite() and their variants.
+struct LineEstimate
+{
+  /// Estimated line position, from 0 for a line under the leftmost sensor to
+  /// 4000 for a line under the rightmost sensor. This uses the same units as
+  /// LineSensors::readLineBlack() but has finer resolution between sensors.
+  uint16_t position;
+
+  /// How clearly the line stands out from the background, from 0 to 1000.
+  /// This is the difference between the calibrated readings of the sensor
+  /// most over the line and the sensor least over it.
+  uint16_t confidence;
+
+  /// Apparent width of the line in thousandths of the spacing between
+  /// sensors. It is the sum of the calibrated readings divided by the
+  /// largest one so a line seen only by one sensor is 1000 wide and a line
+  /// seen fully by all five sensors is 5000 wide.
+  uint16_t width;
+
+  /// True if any sensor saw the line. If not, \ref position is 0 or 4000
+  /// depending on which side the line was last seen on.
+  bool onLine;
+
+  /// True if the line looks too wide to be a single line crossing the
+  /// sensors, such as at an intersection. \ref position is then the
+  /// weighted average of the readings rather than the peak.
+  bool intersection;
+
+  /// True if all of the sensors being read see the line, as happens when a
+  /// black line's sensors are all over a large black area (or off the edge
+  /// of a table). \ref position is then not a useful estimate and \ref
+  /// confidence is low.
+  bool allOnLine;
+};
+
 /// \brief Gets readings from the five reflectance sensors on the bottom of the
 /// 3pi+ 2040.
 ///
@@ -38,6 +90,7 @@ class LineSensors
 {
   private:
     RP2040SIO::Pin<26> emitterPin;
+    RP2040SIO::Pin<23> bumpEmitterPin;
 
 public:
   /// The 3pi+ 2040 has 5 line sensors.
@@ -50,12 +103,56 @@ public:
     memset(calibratedSensorValues, 0, sizeof(calibratedSensorValues));
   }
 
+  /// \brief Sets the timeout for RC sensors.
+  ///
+  /// \param timeout The length of time, in microseconds, beyond which you
+  /// consider the sensor reading completely black. The default is 1024.
+  ///
+  /// If the pulse length for a pin exceeds \p timeout, pulse timing will
+  /// stop and the reading for that pin will be considered full black. The
+  /// maximum reading is the timeout measured in ticks of the QTR tick
+  /// frequency, which is 1 MHz by default, up to a limit of 65535. Shorter
+  /// timeouts allow faster reads on high-contrast surfaces.
+  ///
+  /// The timeout is shared with the bump sensors. You must recalibrate both
+  /// the line and bump sensors after changing it.
+  void setTimeout(uint16_t timeout) { pQTR->setTimeout(timeout); }
+
   /// \brief Returns the timeout.
   ///
   /// \return The RC sensor timeout in microseconds.
   ///
   /// See also setTimeout().
-  uint16_t getTimeout() { return QTRSensors::TIMEOUT; }
+  uint16_t getTimeout() { return pQTR->getTimeout(); }
+
+  /// \brief Returns the largest raw reading that the sensors can report.
+  ///
+  /// \return The raw reading of a sensor which didn't discharge before the
+  /// timeout.
+  ///
+  /// This is 1024 by default and follows the settings made with
+  /// setTimeout().
+  uint16_t getMaxValue() { return pQTR->getMaxReading(); }
+
+  /// \brief Selects which of the line sensors are read.
+  ///
+  /// \param mask A bit mask of the sensors to read, with bit 0 for sensor 0
+  /// (the leftmost) through bit 4 for sensor 4 (the rightmost). The default
+  /// is 0b11111, which reads all five sensors.
+  ///
+  /// The sensors outside of the mask are not charged or timed, so they report
+  /// raw and calibrated values of 0 and don't contribute to the line
+  /// position. Reading a subset, such as the center three sensors with a mask
+  /// of 0b01110, generates less work for the PIO and, with early exit enabled
+  /// in the QTRSensors object, lets a read complete as soon as just those
+  /// sensors have discharged. calibrate() only updates the calibration of the
+  /// sensors in the mask.
+  void setActiveSensors(uint8_t mask) { _activeSensors = mask & ((1 << _sensorCount) - 1); }
+
+  /// \brief Returns the mask of line sensors being read.
+  ///
+  /// See also setActiveSensors().
+  uint8_t getActiveSensors() { return _activeSensors; }
 
   /// \brief Reads the sensors for calibration.
   ///
@@ -85,9 +182,71 @@ public:
   /// \endif
   void calibrate(LineSensorsReadMode mode = LineSensorsReadMode::On);
 
+  /// \brief Reads the sensors for calibration through a LightSensors object.
+  ///
+  /// \param lightSensors The LightSensors object to take the readings with.
+  ///
+  /// \param mode The line emitter behavior during calibration. Only
+  /// LineSensorsReadMode::On and LineSensorsReadMode::Off are supported.
+  ///
+  /// LightSensors::read() turns the bump sensor emitters on along with the
+  /// line sensor emitters, which adds some light to the line sensor
+  /// readings. Use this method instead of calibrate() when the calibrated
+  /// readings will come from read(const LightSensors&),
+  /// readCalibrated(const LightSensors&) or a RobotFrame, so that the
+  /// calibration is taken under the same lighting as those readings. The
+  /// calibration is stored in the same place as calibrate()'s, so it
+  /// shouldn't be mixed with readings taken by this class on its own.
+  void calibrate(LightSensors& lightSensors, LineSensorsReadMode mode = LineSensorsReadMode::On);
+
   /// \brief Resets all calibration that has been done.
   void resetCalibration();
 
+  /// \brief Saves #calibrationOn and #calibrationOff to flash.
+  ///
+  /// \return True if the calibration was saved successfully.
+  ///
+  /// Only calibration data which has been initialized is saved. Any saved
+  /// bump sensor or gyro calibration is kept. This takes about 50 ms so call
+  /// it once after calibrating rather than while driving.
+  bool saveCalibration();
+
+  /// \brief Loads #calibrationOn and #calibrationOff from flash.
+  ///
+  /// \return True if calibration data was loaded; false if none was saved
+  /// or it was saved with a different timeout (see setTimeout()).
+  ///
+  /// This lets a program skip calibrate() after a reset. Calibration data
+  /// which wasn't saved is left unchanged.
+  bool loadCalibration();
+
+  /// \brief Enables or disables continuous calibration from the readings
+  /// taken while the robot drives.
+  ///
+  /// \param enable True to update the calibration with every calibrated
+  /// read; false to only update it from calibrate(). The default is false.
+  ///
+  /// When enabled, readCalibrated(), readLineBlack(), readLineWhite(), and
+  /// the other methods which provide calibrated values first use the new raw
+  /// readings to update #calibrationOn or #calibrationOff, depending on the
+  /// emitter mode. This removes the need to sweep the sensors over the line
+  /// with calibrate() before driving and keeps the calibration valid as the
+  /// lighting changes during a long run.
+  ///
+  /// Until a sensor has seen both the line and the background, its
+  /// calibrated range simply grows to include each new reading. After that,
+  /// readings outside of the range only move it 1/8th of the way towards
+  /// them so that a single bad reading can't stretch it, and the range is
+  /// slowly narrowed every 256 reads so that it can follow the readings if
+  /// they drift down. Any existing calibration, such as from calibrate(), is
+  /// used as the starting point.
+  void setAutoCalibration(bool enable) { _autoCalibration = enable; }
+
+  /// \brief Returns true if continuous calibration is enabled.
+  ///
+  /// See also setAutoCalibration().
+  bool isAutoCalibrationEnabled() { return _autoCalibration; }
+
   /// \brief Reads the raw sensor values into the rawSensorValues member.
   ///
   /// \param mode The emitter behavior during the read, as a member of the
@@ -103,13 +262,121 @@ public:
   /// with higher values corresponding to lower reflectance (e.g. a black
   /// surface or a void).
   ///
-  /// Analog sensors will return a raw value between 0 and 1024 (like
-  /// Arduino's `analogRead()` function).
+  /// The sensors return a raw value between 0 and getMaxValue(), which is
+  /// 1024 by default.
   void read(LineSensorsReadMode mode = LineSensorsReadMode::On)
   {
     readPrivate(mode);
   }
 
+  /// \brief Stores the line sensor values from the most recent
+  /// LightSensors::read() in the rawSensorValues member without reading the
+  /// sensors again.
+  ///
+  /// \param lightSensors The LightSensors object which took the reading.
+  ///
+  /// This allows one reading to be shared with the bump sensors. See
+  /// LightSensors for more information.
+  void read(const LightSensors& lightSensors);
+
+  /// \brief Provides calibrated values in the calibratedSensorValues member
+  /// from the most recent LightSensors::read().
+  ///
+  /// \param lightSensors The LightSensors object which took the reading.
+  ///
+  /// The calibration used depends on the line emitter mode passed to
+  /// LightSensors::read(). See readCalibrated() for a description of the
+  /// values.
+  void readCalibrated(const LightSensors& lightSensors);
+
+  /// \brief Returns an estimated black line position from the most recent
+  /// LightSensors::read().
+  ///
+  /// \param lightSensors The LightSensors object which took the reading.
+  ///
+  /// See readLineBlack() for a description of the return value.
+  uint16_t readLineBlack(const LightSensors& lightSensors)
+  {
+    return readLinePrivate(lightSensors, false);
+  }
+
+  /// \brief Returns an estimated white line position from the most recent
+  /// LightSensors::read().
+  ///
+  /// \param lightSensors The LightSensors object which took the reading.
+  ///
+  /// See readLineWhite() for a description of the return value.
+  uint16_t readLineWhite(const LightSensors& lightSensors)
+  {
+    return readLinePrivate(lightSensors, true);
+  }
+
+  /// \brief Starts reading the sensors in the background.
+  ///
+  /// \param mode The emitter behavior during the read, as a member of the
+  /// ::LineSensorsReadMode enum. The default is LineSensorsReadMode::On.
+  ///
+  /// \return True if the read was started; false if a read from these or the
+  /// bump sensors is already in progress.
+  ///
+  /// The RP2040's PIO times how long each sensor takes to discharge while your
+  /// code does something else, such as reading the IMU or updating a PID
+  /// controller. Call isReadComplete() to check whether the read is done and
+  /// then finishRead(), finishReadCalibrated(), finishReadLineBlack(), or
+  /// finishReadLineWhite() to obtain the results. The emitters are turned on
+  /// and off as needed for \p mode, just like read() does.
+  ///
+  /// A blocking read of the bump sensors made while this read is pending
+  /// completes it first and keeps its results for finishRead(), so the two
+  /// can be mixed freely on one core.
+  ///
+  /// Example usage:
+  /// ~~~{.cpp}
+  /// lineSensors.beginRead();
+  /// imu.readGyro();
+  /// uint16_t position = lineSensors.finishReadLineBlack();
+  /// ~~~
+  bool beginRead(LineSensorsReadMode mode = LineSensorsReadMode::On);
+
+  /// \brief Indicates whether the read started by beginRead() has completed.
+  ///
+  /// \return True if the results are ready to be collected with finishRead()
+  /// or one of its variants; false otherwise. This method never blocks.
+  bool isReadComplete();
+
+  /// \brief Finishes the read started by beginRead() and stores the raw
+  /// sensor values in the rawSensorValues member.
+  ///
+  /// This method waits for the read to complete if isReadComplete() hasn't
+  /// returned true yet. See read() for a description of the values.
+  void finishRead();
+
+  /// \brief Finishes the read started by beginRead() and stores calibrated
+  /// values in the calibratedSensorValues member.
+  ///
+  /// See readCalibrated() for a description of the values. Calibrated
+  /// values are not available for reads started with
+  /// LineSensorsReadMode::Manual.
+  void finishReadCalibrated();
+
+  /// \brief Finishes the read started by beginRead() and returns an
+  /// estimated black line position.
+  ///
+  /// See readLineBlack() for a description of the return value.
+  uint16_t finishReadLineBlack()
+  {
+    return finishReadLinePrivate(false);
+  }
+
+  /// \brief Finishes the read started by beginRead() and returns an
+  /// estimated white line position.
+  ///
+  /// See readLineWhite() for a description of the return value.
+  uint16_t finishReadLineWhite()
+  {
+    return finishReadLinePrivate(true);
+  }
+
   /// \brief Reads the sensors and provides calibrated values between 0 and
   /// 1000 in the calibratedSensorValues member.
   ///
@@ -184,6 +451,85 @@ public:
     return readLinePrivate(mode, true);
   }
 
+  /// \brief Reads the sensors, provides calibrated values, and returns a
+  /// higher resolution estimate of a black line's position.
+  ///
+  /// \param mode The emitter behavior during the read, as a member of the
+  /// ::LineSensorsReadMode enum. The default is LineSensorsReadMode::On. Manual
+  /// emitter control with LineSensorsReadMode::Manual is not supported.
+  ///
+  /// \return A LineEstimate describing the line under the sensors.
+  ///
+  /// Instead of the weighted average used by readLineBlack(), this fits a
+  /// parabola through the sensor with the highest calibrated reading and its
+  /// two neighbors and returns the position of its vertex. The position
+  /// changes smoothly as the line moves between sensors and isn't pulled
+  /// around by noise on sensors far from the line, which gives a PID
+  /// controller a cleaner error signal. The returned LineEstimate also
+  /// indicates how confident the estimate is and flags intersections and
+  /// all-black readings. Everything is calculated with integer math.
+  ///
+  /// Like readLineBlack(), this remembers which side the line was last seen
+  /// on when it is lost.
+  LineEstimate readLineEstimateBlack(LineSensorsReadMode mode = LineSensorsReadMode::On)
+  {
+    return readLineEstimatePrivate(mode, false);
+  }
+
+  /// \brief Reads the sensors, provides calibrated values, and returns a
+  /// higher resolution estimate of a white line's position.
+  ///
+  /// \param mode The emitter behavior during the read, as a member of the
+  /// ::LineSensorsReadMode enum. The default is LineSensorsReadMode::On. Manual
+  /// emitter control with LineSensorsReadMode::Manual is not supported.
+  ///
+  /// \return A LineEstimate describing the line under the sensors.
+  ///
+  /// See readLineEstimateBlack() for details.
+  LineEstimate readLineEstimateWhite(LineSensorsReadMode mode = LineSensorsReadMode::On)
+  {
+    return readLineEstimatePrivate(mode, true);
+  }
+
+  /// \brief Returns a higher resolution estimate of a black line's position
+  /// from the most recent LightSensors::read().
+  ///
+  /// \param lightSensors The LightSensors object which took the reading.
+  ///
+  /// See readLineEstimateBlack() for details.
+  LineEstimate readLineEstimateBlack(const LightSensors& lightSensors)
+  {
+    return readLineEstimatePrivate(lightSensors, false);
+  }
+
+  /// \brief Returns a higher resolution estimate of a white line's position
+  /// from the most recent LightSensors::read().
+  ///
+  /// \param lightSensors The LightSensors object which took the reading.
+  ///
+  /// See readLineEstimateBlack() for details.
+  LineEstimate readLineEstimateWhite(const LightSensors& lightSensors)
+  {
+    return readLineEstimatePrivate(lightSensors, true);
+  }
+
+  /// \brief Finishes the read started by beginRead() and returns a higher
+  /// resolution estimate of a black line's position.
+  ///
+  /// See readLineEstimateBlack() for details.
+  LineEstimate finishReadLineEstimateBlack()
+  {
+    return finishReadLineEstimatePrivate(false);
+  }
+
+  /// \brief Finishes the read started by beginRead() and returns a higher
+  /// resolution estimate of a white line's position.
+  ///
+  /// See readLineEstimateBlack() for details.
+  LineEstimate finishReadLineEstimateWhite()
+  {
+    return finishReadLineEstimatePrivate(true);
+  }
 
   /// \brief Stores sensor calibration data.
   ///
@@ -196,20 +542,79 @@ public:
     LineSensorReadings maximum;
     /// Has calibration been run to initialize this structure.
     bool initialized;
+    /// Fixed-point reciprocals of each sensor's calibrated range, scaled so
+    /// that `(x * scale) >> scaleShift` is `x * 1000 / range`. These are
+    /// maintained by calibrate(), loadCalibration(), resetCalibration() and
+    /// updateScales().
+    uint32_t scale[_sensorCount];
+
+    /// Number of fractional bits in the scale values. This is as many as
+    /// can be used without `x * scale` overflowing 32 bits for any
+    /// 16-bit range.
+    static const uint8_t scaleShift = 22;
 
     CalibrationData()
     {
         init();
     }
 
-    void init()
+    /// Resets the calibration data. The minimums start out at \p maxValue,
+    /// the largest possible raw reading.
+    void init(uint16_t maxValue = QTRSensors::TIMEOUT)
     {
       for (uint8_t i = 0; i < _sensorCount; i++)
       {
         maximum.vals[i] = 0;
-        minimum.vals[i] = QTRSensors::TIMEOUT;
+        minimum.vals[i] = maxValue;
         initialized = false;
       }
+      updateScales();
+    }
+
+    /// Recalculates the scale values from the current minimum and maximum.
+    ///
+    /// The methods which change the calibration call this for you. Call it
+    /// yourself after changing the minimum or maximum directly (e.g. when
+    /// restoring them from your own storage). Calibrated reads only use the
+    /// scale values, so they aren't recalculated while reading.
+    void updateScales()
+    {
+      for (uint8_t i = 0; i < _sensorCount; i++)
+      {
+        updateScale(i);
+      }
+    }
+
+    /// Recalculates the scale value for sensor \p i.
+    void updateScale(uint8_t i)
+    {
+      uint16_t range = maximum.vals[i] - minimum.vals[i];
+      // Round up so that the truncated product is never less than the
+      // quotient. It is exact for ranges up to 2048 and at most 1 high
+      // beyond that.
+      scale[i] = range ? ((1000UL << scaleShift) + range - 1) / range : 0;
+    }
+
+    /// Converts a raw reading from sensor \p i into a calibrated value from
+    /// 0 to 1000 using the precomputed scale.
+    uint16_t calibrateValue(uint8_t i, uint16_t rawValue) const
+    {
+      uint16_t calmin = minimum.vals[i];
+      uint16_t denominator = maximum.vals[i] - calmin;
+      int32_t  offset = ((int32_t)rawValue) - calmin;
+
+      // Clamp before scaling so that the offset is less than the denominator
+      // and the multiply can't overflow. The scale is a precomputed
+      // reciprocal of the denominator so no divide is needed.
+      if (denominator == 0 || offset <= 0)
+      {
+        return 0;
+      }
+      if ((uint32_t)offset >= denominator)
+      {
+        return 1000;
+      }
+      return ((uint32_t)offset * scale[i]) >> scaleShift;
     }
   };
 
@@ -219,10 +624,12 @@ public:
   ///
   /// These variables are made public so that you can use them for your own
   /// calculations and do things like saving the values to EEPROM, performing
-  /// sanity checking, etc.
+  /// sanity checking, etc. Call CalibrationData::updateScales() after
+  /// changing their minimum or maximum values.
   /// \{
 
-  /// Data from calibrating with emitters on.
+  /// Data from calibrating with emitters on (also used for the OnAndOff
+  /// mode).
   CalibrationData calibrationOn;
 
   /// Data from calibrating with emitters off.
@@ -256,22 +663,51 @@ private:
 
   // Handles the actual calibration, including (re)allocating and
   // initializing the storage for the calibration values if necessary.
-  void calibrateOnOrOff(CalibrationData & calibration, LineSensorsReadMode mode);
+  // The readings are taken through pLightSensors if it isn't NULL.
+  void calibrateOnOrOff(CalibrationData & calibration, LineSensorsReadMode mode, LightSensors * pLightSensors = NULL);
+
+  // Updates the calibration from the current raw values for setAutoCalibration().
+  void autoCalibrate(CalibrationData & calibration);
 
   void readPrivate(LineSensorsReadMode mode);
-  void readPrivate();
 
   void readCalibratedPrivate(LineSensorsReadMode mode);
   void readCalibratedPrivate(CalibrationData& calibration, LineSensorsReadMode mode);
+  void calibrateRawValues(LineSensorsReadMode mode);
+  void calibrateRawValues(CalibrationData& calibration);
 
   uint16_t readLinePrivate(LineSensorsReadMode mode, bool invertReadings);
+  uint16_t readLinePrivate(const LightSensors& lightSensors, bool invertReadings);
+  uint16_t finishReadLinePrivate(bool invertReadings);
+  uint16_t calculateLinePosition(bool invertReadings);
+  LineEstimate readLineEstimatePrivate(LineSensorsReadMode mode, bool invertReadings);
+  LineEstimate readLineEstimatePrivate(const LightSensors& lightSensors, bool invertReadings);
+  LineEstimate finishReadLineEstimatePrivate(bool invertReadings);
+  LineEstimate estimateLinePosition(bool invertReadings);
+
+  uint8_t getQTRMask();
+  void storeRawValues(const QTRSensorReadings& readings);
+  void storeOnAndOffValues(const QTRSensorReadings& offReadings);
 
   /// Pointer to the QTR sensor reading singleton shared with the bumper sensors.
   QTRSensors* pQTR;
 
-  uint16_t _timeout = QTRSensors::TIMEOUT;
-  uint16_t _maxValue = QTRSensors::TIMEOUT; // the maximum value returned by readPrivate()
+  /// Emitter mode of the read started by beginRead().
+  LineSensorsReadMode _pendingMode = LineSensorsReadMode::On;
+  /// Has beginRead() started a read that hasn't been finished yet?
+  bool _readPending = false;
+  /// Is an OnAndOff read taking its emitters off reading?
+  bool _offPhase = false;
+  /// Emitters on readings of an OnAndOff read.
+  QTRSensorReadings _onReadings;
+
+  /// Mask of the sensors to be read, with bit 0 for sensor 0.
+  uint8_t _activeSensors = (1 << _sensorCount) - 1;
   uint16_t _lastPosition = 0;
+  /// Should calibrated reads update the calibration too?
+  bool _autoCalibration = false;
+  /// Number of automatically calibrated reads, used to time the decay.
+  uint8_t _autoCalibrationReads = 0;
 };
 
 }
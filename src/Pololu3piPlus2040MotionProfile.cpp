@@ -0,0 +1,345 @@
+// Copyright (C) Pololu Corporation.  See www.pololu.com for details.
+
+#include <hardware/sync.h>
+#include "Pololu3piPlus2040MotionProfile.h"
+
+namespace Pololu3piPlus2040
+{
+
+static const int64_t one = (int64_t)1 << 16;
+
+// Hardware spin lock that protects the state of every profile so that update() can run in an interrupt handler or on
+// the other core while the profile is read or given a new move. The 64-bit fields could otherwise be torn.
+static spin_lock_t * profileLock = NULL;
+
+static int64_t absolute(int64_t value)
+{
+  return (value < 0) ? -value : value;
+}
+
+static int64_t clamp(int64_t value, int64_t limit)
+{
+  if (value > limit)
+  {
+    return limit;
+  }
+  if (value < -limit)
+  {
+    return -limit;
+  }
+  return value;
+}
+
+// Returns the integer square root of value, rounded down.
+static uint64_t squareRoot(uint64_t value)
+{
+  uint64_t result = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+  while (bit > value)
+  {
+    bit >>= 2;
+  }
+  while (bit != 0)
+  {
+    if (value >= result + bit)
+    {
+      value -= result + bit;
+      result = (result >> 1) + bit;
+    }
+    else
+    {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+  return result;
+}
+
+MotionProfile::MotionProfile()
+{
+  if (profileLock == NULL)
+  {
+    profileLock = spin_lock_init(spin_lock_claim_unused(true));
+  }
+  period = 1000;
+  setLimits(2000, 4000, 0);
+  reset();
+}
+
+void MotionProfile::setLimits(int32_t newMaxVelocity, int32_t newMaxAcceleration, int32_t newMaxJerk)
+{
+  uint32_t lockState = spin_lock_blocking(profileLock);
+  maxVelocity = (newMaxVelocity < 0) ? -newMaxVelocity : newMaxVelocity;
+  maxAcceleration = (newMaxAcceleration < 0) ? -newMaxAcceleration : newMaxAcceleration;
+  if (maxAcceleration == 0)
+  {
+    maxAcceleration = 1;
+  }
+  maxJerk = (newMaxJerk < 0) ? -newMaxJerk : newMaxJerk;
+  spin_unlock(profileLock, lockState);
+}
+
+void MotionProfile::setPeriod(uint32_t periodUs)
+{
+  uint32_t lockState = spin_lock_blocking(profileLock);
+  period = periodUs;
+  spin_unlock(profileLock, lockState);
+}
+
+void MotionProfile::reset(int64_t newPosition, int32_t newVelocity)
+{
+  uint32_t lockState = spin_lock_blocking(profileLock);
+  position = newPosition * one;
+  velocity = (int64_t)newVelocity * one;
+  acceleration = 0;
+  targetPosition = position;
+  targetVelocity = velocity;
+  positionMode = false;
+  done = true;
+  spin_unlock(profileLock, lockState);
+}
+
+void MotionProfile::moveTo(int64_t newPosition)
+{
+  uint32_t lockState = spin_lock_blocking(profileLock);
+  targetPosition = newPosition * one;
+  positionMode = true;
+  done = false;
+  spin_unlock(profileLock, lockState);
+}
+
+void MotionProfile::moveAtVelocity(int32_t newVelocity)
+{
+  uint32_t lockState = spin_lock_blocking(profileLock);
+  targetVelocity = clamp((int64_t)newVelocity * one, (int64_t)maxVelocity * one);
+  positionMode = false;
+  done = false;
+  spin_unlock(profileLock, lockState);
+}
+
+bool MotionProfile::isDone()
+{
+  uint32_t lockState = spin_lock_blocking(profileLock);
+  bool result = done;
+  spin_unlock(profileLock, lockState);
+  return result;
+}
+
+int64_t MotionProfile::getPosition()
+{
+  uint32_t lockState = spin_lock_blocking(profileLock);
+  int64_t result = (position + one / 2) >> 16;
+  spin_unlock(profileLock, lockState);
+  return result;
+}
+
+int32_t MotionProfile::getVelocity()
+{
+  uint32_t lockState = spin_lock_blocking(profileLock);
+  int32_t result = (int32_t)(velocity / one);
+  spin_unlock(profileLock, lockState);
+  return result;
+}
+
+int32_t MotionProfile::getAcceleration()
+{
+  uint32_t lockState = spin_lock_blocking(profileLock);
+  int32_t result = (int32_t)(acceleration / one);
+  spin_unlock(profileLock, lockState);
+  return result;
+}
+
+// Returns how much a rate of change changes the quantity in one period.
+int64_t MotionProfile::perPeriod(int64_t value)
+{
+  return value * period / 1000000;
+}
+
+// Multiplies two fixed-point numbers.
+static int64_t multiply(int64_t a, int64_t b)
+{
+  return (a * b) >> 16;
+}
+
+// Divides two fixed-point numbers.
+static int64_t divide(int64_t a, int64_t b)
+{
+  return (a << 16) / b;
+}
+
+// Returns the distance, in fixed-point counts, that the profile would travel if it started braking right now from the
+// given velocity and acceleration, which are both signed so that positive values are toward the target.
+int64_t MotionProfile::stoppingDistance(int64_t v, int64_t a)
+{
+  if (v <= 0)
+  {
+    // Already stopped or heading away from the target.
+    return 0;
+  }
+
+  int64_t maxAccel = (int64_t)maxAcceleration * one;
+  if (maxJerk == 0)
+  {
+    // d = v^2 / (2 a)
+    return divide(multiply(v, v), 2 * maxAccel);
+  }
+
+  // With a jerk limit, braking takes up to three phases: ramp the acceleration down to the peak deceleration, hold
+  // it there, and then ramp it back up to zero just as the velocity reaches zero. The peak deceleration is the
+  // maximum unless the velocity is low enough to stop without reaching it.
+  int64_t jerk = (int64_t)maxJerk * one;
+  int64_t peak = (int64_t)squareRoot(maxJerk * (v >> 16) + (a >> 16) * (a >> 16) / 2) * one;
+  if (peak > maxAccel)
+  {
+    peak = maxAccel;
+  }
+  if (peak < -a)
+  {
+    // Already decelerating harder than that, so just ramp back up to zero.
+    peak = -a;
+  }
+
+  int64_t t1 = divide(a + peak, jerk);
+  int64_t x1 = multiply(v, t1) + multiply(multiply(a, t1), t1) / 2 -
+    multiply(multiply(multiply(jerk, t1), t1), t1) / 6;
+  int64_t v1 = v + multiply(a, t1) - multiply(multiply(jerk, t1), t1) / 2;
+
+  int64_t t3 = divide(peak, jerk);
+  int64_t t2 = 0;
+  if (peak > 0)
+  {
+    t2 = divide(v1 - multiply(peak, t3) / 2, peak);
+    if (t2 < 0)
+    {
+      t2 = 0;
+    }
+  }
+  int64_t x2 = multiply(v1, t2) - multiply(multiply(peak, t2), t2) / 2;
+  int64_t v2 = v1 - multiply(peak, t2);
+
+  int64_t x3 = multiply(v2, t3) - multiply(multiply(peak, t3), t3) / 2 +
+    multiply(multiply(multiply(jerk, t3), t3), t3) / 6;
+
+  return x1 + x2 + x3;
+}
+
+// Returns how much the velocity changes while the acceleration is ramped back down to zero, one jerk step per period,
+// the same way that rampVelocity() does it.
+int64_t MotionProfile::rampDownChange(int64_t a, int64_t jerkStep)
+{
+  int64_t magnitude = absolute(a);
+  int64_t steps = magnitude / jerkStep;
+  int64_t change = perPeriod(steps * magnitude - jerkStep * steps * (steps + 1) / 2);
+  return (a < 0) ? -change : change;
+}
+
+// Moves the velocity one period closer to the target without exceeding the acceleration and jerk limits.
+void MotionProfile::rampVelocity(int64_t target)
+{
+  int64_t maxAccel = (int64_t)maxAcceleration * one;
+  int64_t accelStep = perPeriod(maxAccel);
+
+  if (maxJerk == 0)
+  {
+    // Trapezoidal profile: the acceleration can change instantly.
+    int64_t change = clamp(target - velocity, accelStep);
+    velocity += change;
+    acceleration = (absolute(change) < accelStep) ? 0 : ((change < 0) ? -maxAccel : maxAccel);
+    return;
+  }
+
+  int64_t jerkStep = perPeriod((int64_t)maxJerk * one);
+  if (jerkStep == 0)
+  {
+    jerkStep = 1;
+  }
+  int64_t error = target - velocity;
+  if (absolute(error) <= perPeriod(jerkStep) && absolute(acceleration) <= jerkStep)
+  {
+    // Close enough to finish this period.
+    velocity = target;
+    acceleration = 0;
+    return;
+  }
+
+  // Use the largest acceleration toward the target, within one jerk step of the current one, that still leaves room
+  // to ramp it back down to zero by the time that the velocity reaches the target.
+  int64_t direction = (error < 0) ? -1 : 1;
+  int64_t remaining = direction * error;
+  int64_t lowest = clamp(direction * acceleration - jerkStep, maxAccel);
+  int64_t a = clamp(direction * acceleration + jerkStep, maxAccel);
+  while (a > lowest && perPeriod(a) + rampDownChange(a, jerkStep) > remaining)
+  {
+    a = (a - jerkStep > lowest) ? a - jerkStep : lowest;
+  }
+  acceleration = direction * a;
+  velocity += perPeriod(acceleration);
+}
+
+void MotionProfile::update()
+{
+  uint32_t lockState = spin_lock_blocking(profileLock);
+  updateLocked();
+  spin_unlock(profileLock, lockState);
+}
+
+void MotionProfile::updateLocked()
+{
+  int64_t lastVelocity = velocity;
+
+  if (positionMode)
+  {
+    int64_t distance = targetPosition - position;
+    int64_t stopStep = perPeriod((int64_t)maxAcceleration * one);
+    int64_t jerkStep = (maxJerk == 0) ? absolute(acceleration) : perPeriod((int64_t)maxJerk * one);
+    if (absolute(distance) < one && absolute(velocity) <= stopStep && absolute(acceleration) <= jerkStep)
+    {
+      // Close enough to stop on the target within one period, without the acceleration having to drop by more than
+      // the jerk limit allows.
+      position = targetPosition;
+      velocity = 0;
+      acceleration = 0;
+      done = true;
+      return;
+    }
+
+    // Keep speeding up toward the target as long as the profile could still stop in time after speeding up for one
+    // more period.
+    int64_t direction = (distance < 0) ? -1 : 1;
+    int64_t v = direction * velocity;
+    int64_t a = direction * acceleration;
+    int64_t maxAccel = (int64_t)maxAcceleration * one;
+    int64_t nextA = (maxJerk == 0) ? maxAccel : a + perPeriod((int64_t)maxJerk * one);
+    if (nextA > maxAccel)
+    {
+      nextA = maxAccel;
+    }
+    int64_t nextV = v + perPeriod(nextA);
+    int64_t brakingDistance = perPeriod((v + nextV) / 2) + stoppingDistance(nextV, nextA);
+    if (maxJerk != 0)
+    {
+      // The acceleration is ramped down one jerk step per period, which can take up to a period longer to stop than
+      // the continuous stopping distance allows for. Without this margin the profile would overshoot and have to
+      // back up onto the target.
+      brakingDistance += perPeriod(nextV);
+    }
+    if (brakingDistance >= absolute(distance))
+    {
+      rampVelocity(0);
+    }
+    else
+    {
+      rampVelocity(direction * maxVelocity * one);
+    }
+  }
+  else
+  {
+    rampVelocity(targetVelocity);
+    done = (velocity == targetVelocity);
+  }
+
+  // Integrate with the average of the old and new velocities.
+  position += perPeriod((lastVelocity + velocity) / 2);
+}
+
+}
@@ -0,0 +1,134 @@
+// Copyright (C) Pololu Corporation.  See www.pololu.com for details.
+
+/// \file Pololu3piPlus2040MotionProfile.h
+
+#pragma once
+
+#include <stdint.h>
+
+namespace Pololu3piPlus2040
+{
+
+/// \brief Generates smooth position and velocity setpoints for a wheel.
+///
+/// Jumping straight to a new motor speed makes the wheels slip, which
+/// throws off the encoder counts and makes the robot's moves inconsistent.
+/// This class ramps the setpoints instead, one update at a time, so that
+/// the velocity never changes faster than the acceleration limit. With a
+/// jerk limit, the acceleration also ramps up and down, which gives an
+/// S-curve profile that is even gentler on the wheels' grip; without one,
+/// the profile is trapezoidal.
+///
+/// Call update() once per control period, for example from the same
+/// place that feeds a WheelSpeedController or Motors::setSpeeds(), and
+/// then use getVelocity() (and getPosition() if you are controlling the
+/// position) as the targets. Use one MotionProfile for each wheel.
+///
+/// Everything is calculated in 48.16 fixed-point, so update() is fast
+/// enough to call from an interrupt. The profiles share a hardware spin
+/// lock, so the other methods can safely be called from the main loop or
+/// the other core while update() runs in an interrupt handler.
+///
+/// Example usage:
+/// ~~~{.cpp}
+/// MotionProfile leftProfile, rightProfile;
+/// leftProfile.setLimits(3000, 6000, 60000);
+/// rightProfile.setLimits(3000, 6000, 60000);
+/// leftProfile.moveTo(leftProfile.getPosition() + 1000);
+/// rightProfile.moveTo(rightProfile.getPosition() + 1000);
+/// ...
+/// // Every millisecond:
+/// leftProfile.update();
+/// rightProfile.update();
+/// speedController.setTargetCountsPerSecond(leftProfile.getVelocity(),
+///   rightProfile.getVelocity());
+/// ~~~
+class MotionProfile
+{
+  public:
+    MotionProfile();
+
+    /// \brief Sets the limits of the profile.
+    ///
+    /// \param maxVelocity The maximum speed in counts per second.
+    /// \param maxAcceleration The maximum acceleration in counts per second
+    /// squared. It must be greater than 0.
+    /// \param maxJerk The maximum rate of change of the acceleration in
+    /// counts per second cubed, or 0 for no limit (a trapezoidal profile).
+    ///
+    /// The limits can be changed at any time and apply from the next
+    /// update(). The defaults are 2000, 4000, and 0.
+    void setLimits(int32_t maxVelocity, int32_t maxAcceleration, int32_t maxJerk = 0);
+
+    /// \brief Sets the time between calls to update() in microseconds.
+    ///
+    /// The default is 1000.
+    void setPeriod(uint32_t periodUs);
+
+    /// \brief Sets the current position and velocity without any ramping,
+    /// and stops any move in progress.
+    ///
+    /// \param position The new position in counts.
+    /// \param velocity The new velocity in counts per second.
+    void reset(int64_t position = 0, int32_t velocity = 0);
+
+    /// \brief Starts a move to the given position.
+    ///
+    /// The profile speeds up to at most the maximum velocity and then slows
+    /// down so that it comes to a stop at \p position. If it was already
+    /// moving, it carries on from its current velocity and acceleration.
+    void moveTo(int64_t position);
+
+    /// \brief Starts ramping to the given velocity and then keeps moving at
+    /// it.
+    ///
+    /// \param velocity The target velocity in counts per second. It is
+    /// limited to the maximum velocity.
+    void moveAtVelocity(int32_t velocity);
+
+    /// \brief Advances the profile by one period.
+    void update();
+
+    /// \brief Returns true if the profile has reached its target position
+    /// or velocity.
+    bool isDone();
+
+    /// \brief Returns the position setpoint in counts.
+    int64_t getPosition();
+
+    /// \brief Returns the velocity setpoint in counts per second.
+    int32_t getVelocity();
+
+    /// \brief Returns the acceleration setpoint in counts per second
+    /// squared.
+    int32_t getAcceleration();
+
+  private:
+    /// Limits in counts, seconds, and combinations of them.
+    int32_t maxVelocity;
+    int32_t maxAcceleration;
+    int32_t maxJerk;
+    uint32_t period;
+
+    /// State in 48.16 fixed-point counts, seconds, and combinations of them.
+    int64_t position;
+    int64_t velocity;
+    int64_t acceleration;
+
+    /// Target position in 48.16 fixed-point counts, used when moving to a
+    /// position.
+    int64_t targetPosition;
+    /// Target velocity in 48.16 fixed-point counts per second, used when
+    /// moving at a velocity.
+    int64_t targetVelocity;
+    bool positionMode;
+    bool done;
+
+    int64_t stoppingDistance(int64_t v, int64_t a);
+    int64_t rampDownChange(int64_t a, int64_t jerkStep);
+    void rampVelocity(int64_t target);
+    void updateLocked();
+    int64_t perPeriod(int64_t value);
+};
+
+}
@@ -1,30 +1,81 @@
 // Copyright (C) Pololu Corporation.  See www.pololu.com for details.
 
-#include <mbed.h>
+#include <hardware/pwm.h>
+#include <hardware/clocks.h>
+#include <hardware/irq.h>
+#include <hardware/sync.h>
 #include "Pololu3piPlus2040Motors.h"
 #include "RP2040SIO.h"
 
 namespace Pololu3piPlus2040
 {
 // Configure the direction pins to be output with a default value of 0.
-static RP2040SIO::Pin<10> rightDirectionPin(true, false, false, false);
-static RP2040SIO::Pin<11> leftDirectionPin(true, false, false, false);
-static mbed::PwmOut rightPWM(p14);
-static mbed::PwmOut leftPWM(p15);
+static const uint32_t rightDirectionPinNo = 10;
+static const uint32_t leftDirectionPinNo = 11;
+static RP2040SIO::Pin<rightDirectionPinNo> rightDirectionPin(true, false, false, false);
+static RP2040SIO::Pin<leftDirectionPinNo> leftDirectionPin(true, false, false, false);
+static const uint32_t rightDirectionMask = 1 << rightDirectionPinNo;
+static const uint32_t leftDirectionMask = 1 << leftDirectionPinNo;
 static bool flipLeft = false;
 static bool flipRight = false;
 
+// Both PWM pins are driven by the same PWM slice, the right motor from channel A and the left from channel B.
+static const uint32_t rightPWMPin = 14;
+static const uint32_t leftPWMPin = 15;
+static uint32_t pwmSlice;
+
 // PWM frequency of 20kHz.
 const uint32_t pwmFrequency = 20000;
-const uint32_t pwmPeriod_us = 1000000 / pwmFrequency;
 
-// initialize timer1 to generate the proper PWM outputs to the motor drivers
+// Number of PWM counter ticks in each period, which is also the duty level for 100% on.
+static uint16_t maxDuty = 0;
+
+// The latest PWM levels and direction pin outputs requested for the motors.
+static uint16_t rightLevel = 0;
+static uint16_t leftLevel = 0;
+static uint32_t directions = 0;
+// Set when the PWM wrap interrupt still has to commit the requested levels and directions.
+static bool commitPending = false;
+// Direction pins of the motors which have been turned off for the pending commit.
+static uint32_t zeroedDirections = 0;
+// Hardware spin lock that protects the requested settings from the PWM wrap interrupt and the other core.
+static spin_lock_t * motorLock = NULL;
+
+static void pwmWrapInterruptHandler();
+
+// Each battery voltage reading moves the filtered voltage 1/2^batteryFilterShift of the way toward it.
+static const uint32_t batteryFilterShift = 4;
+// Filtered battery voltage in millivolts, scaled by 2^batteryFilterShift, or 0 if it hasn't been read yet.
+static volatile uint32_t filteredBatteryMillivolts = 0;
+// Battery voltage that the duty cycles are scaled to, in millivolts, or 0 if compensation is disabled.
+static volatile uint32_t nominalMillivolts = 0;
+
+// Configure the PWM slice to generate the PWM outputs to the motor drivers directly from the system clock so that
+// the duty cycle can be set to the resolution of a single clock cycle.
 void Motors::init2()
 {
-    rightPWM.period_us(pwmPeriod_us);
-    leftPWM.period_us(pwmPeriod_us);
-    rightPWM.pulsewidth_us(0);
-    leftPWM.pulsewidth_us(0);
+    uint32_t ticks = clock_get_hz(clk_sys) / pwmFrequency;
+    assert ( ticks <= 65535 );
+    maxDuty = (uint16_t)ticks;
+
+    pwmSlice = pwm_gpio_to_slice_num(rightPWMPin);
+    assert ( pwmSlice == pwm_gpio_to_slice_num(leftPWMPin) );
+    assert ( pwm_gpio_to_channel(rightPWMPin) == PWM_CHAN_A && pwm_gpio_to_channel(leftPWMPin) == PWM_CHAN_B );
+
+    pwm_set_enabled(pwmSlice, false);
+    pwm_set_clkdiv_int_frac(pwmSlice, 1, 0);
+    pwm_set_phase_correct(pwmSlice, false);
+    pwm_set_wrap(pwmSlice, maxDuty - 1);
+    pwm_set_both_levels(pwmSlice, 0, 0);
+    gpio_set_function(rightPWMPin, GPIO_FUNC_PWM);
+    gpio_set_function(leftPWMPin, GPIO_FUNC_PWM);
+    pwm_set_enabled(pwmSlice, true);
+
+    // The wrap interrupt is only enabled while a change of direction is waiting to be committed.
+    motorLock = spin_lock_init(spin_lock_claim_unused(true));
+    directions = sio_hw->gpio_out & (rightDirectionMask | leftDirectionMask);
+    irq_add_shared_handler(PWM_IRQ_WRAP, pwmWrapInterruptHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(PWM_IRQ_WRAP, true);
 }
 
 void Motors::flipLeftMotor(bool flip)
@@ -37,50 +88,200 @@ void Motors::flipRightMotor(bool flip)
     flipRight = flip;
 }
 
-void Motors::setLeftSpeed(int16_t speed)
+// Commits the requested levels and directions. Must be called with motorLock held.
+//
+// The compare register is double buffered, so the new levels for both motors always take effect together at the
+// next wrap of the PWM counter. If a direction pin has to change, that motor is turned off at the next wrap instead
+// and the wrap interrupt then changes the direction pins together and writes the new levels for both motors, which
+// take effect at the wrap after that. This way a direction pin never changes while its motor is being driven.
+static void commitLevels()
 {
-    init();
+    uint32_t changed = (sio_hw->gpio_out ^ directions) & (rightDirectionMask | leftDirectionMask);
+    if (!commitPending && changed == 0)
+    {
+        pwm_set_both_levels(pwmSlice, rightLevel, leftLevel);
+        return;
+    }
+    if ((changed & ~zeroedDirections) == 0)
+    {
+        // The wrap interrupt will pick up the latest request.
+        return;
+    }
+
+    // Turn off the motors whose direction pins have to change, along with any that were already being turned off,
+    // and leave the other one as it is.
+    zeroedDirections |= changed;
+    uint32_t cc = pwm_hw->slice[pwmSlice].cc;
+    uint16_t currentRight = (zeroedDirections & rightDirectionMask) ? 0 : (uint16_t)(cc >> PWM_CH0_CC_A_LSB);
+    uint16_t currentLeft = (zeroedDirections & leftDirectionMask) ? 0 : (uint16_t)(cc >> PWM_CH0_CC_B_LSB);
+    pwm_set_both_levels(pwmSlice, currentRight, currentLeft);
+    commitPending = true;
+    // Clear the interrupt after writing the levels so that it can't fire before they have taken effect. When a commit
+    // was already pending, this also makes it wait for the wrap at which the newly turned off motor stops.
+    pwm_clear_irq(pwmSlice);
+    pwm_set_irq_enabled(pwmSlice, true);
+}
+
+static void pwmWrapInterruptHandler()
+{
+    if ((pwm_get_irq_status_mask() & (1 << pwmSlice)) == 0)
+    {
+        return;
+    }
+    pwm_clear_irq(pwmSlice);
 
-    bool reverse = 0;
+    uint32_t lockState = spin_lock_blocking(motorLock);
+    pwm_set_irq_enabled(pwmSlice, false);
+    if (commitPending)
+    {
+        // Toggle the pins which need to change with a single write so that both directions change together. Only the
+        // motors which have been turned off can change direction.
+        sio_hw->gpio_togl = (sio_hw->gpio_out ^ directions) & zeroedDirections;
+        pwm_set_both_levels(pwmSlice, rightLevel, leftLevel);
+        zeroedDirections = 0;
+        commitPending = false;
+    }
+    spin_unlock(motorLock, lockState);
+}
+
+// Limits the duty cycle to the allowed range and splits it into a PWM level and a direction, scaling it to make up
+// for the battery voltage if compensation is enabled.
+static uint16_t dutyToLevel(int32_t duty, bool & reverse)
+{
+    reverse = 0;
 
-    if (speed < 0)
+    if (duty < 0)
     {
-        speed = -speed; // Make speed a positive quantity.
+        duty = -duty;   // Make duty a positive quantity.
         reverse = 1;    // Preserve the direction.
     }
+    uint32_t nominal = nominalMillivolts;
+    uint32_t battery = filteredBatteryMillivolts >> batteryFilterShift;
+    if (nominal != 0 && battery != 0 && duty <= maxDuty)
+    {
+        duty = (int32_t)((uint32_t)duty * nominal / battery);
+    }
+    if (duty > maxDuty)
+    {
+        duty = maxDuty;
+    }
+
+    return (uint16_t)duty;
+}
+
+// Converts a speed from -400 to 400 into a duty cycle from -maxDuty to maxDuty.
+static int32_t speedToDuty(int16_t speed)
+{
     if (speed > 400)
     {
         speed = 400;
     }
+    else if (speed < -400)
+    {
+        speed = -400;
+    }
 
-    leftPWM.pulsewidth_us(map(speed, 0, 400, 0, pwmPeriod_us));
-    leftDirectionPin.setOutput(reverse ^ flipLeft);
+    return (int32_t)speed * maxDuty / 400;
 }
 
-void Motors::setRightSpeed(int16_t speed)
+void Motors::enableBatteryCompensation(uint16_t nominal)
 {
-    init();
+    nominalMillivolts = nominal;
+}
 
-    bool reverse = 0;
+void Motors::disableBatteryCompensation()
+{
+    nominalMillivolts = 0;
+}
 
-    if (speed < 0)
+void Motors::updateBatteryMillivolts(uint16_t millivolts)
+{
+    // Only one place reads the battery voltage at a time, either readBatteryMillivolts() or the SensorService.
+    uint32_t filtered = filteredBatteryMillivolts;
+    if (filtered == 0)
     {
-        speed = -speed;  // Make speed a positive quantity.
-        reverse = 1;     // Preserve the direction.
+        filtered = (uint32_t)millivolts << batteryFilterShift;
     }
-    if (speed > 400)
+    else
     {
-        speed = 400;
+        filtered = filtered - (filtered >> batteryFilterShift) + millivolts;
     }
+    filteredBatteryMillivolts = filtered;
+}
+
+uint16_t Motors::getBatteryMillivolts()
+{
+    return filteredBatteryMillivolts >> batteryFilterShift;
+}
+
+uint16_t Motors::getMaxDuty()
+{
+    init();
+
+    return maxDuty;
+}
+
+void Motors::setLeftDuty(int32_t duty)
+{
+    init();
+
+    bool reverse;
+    uint16_t level = dutyToLevel(duty, reverse);
+    uint32_t lockState = spin_lock_blocking(motorLock);
+    leftLevel = level;
+    directions = (reverse ^ flipLeft) ? (directions | leftDirectionMask) : (directions & ~leftDirectionMask);
+    commitLevels();
+    spin_unlock(motorLock, lockState);
+}
+
+void Motors::setRightDuty(int32_t duty)
+{
+    init();
 
-    rightPWM.pulsewidth_us(map(speed, 0, 400, 0, pwmPeriod_us));
-    rightDirectionPin.setOutput(reverse ^ flipRight);
+    bool reverse;
+    uint16_t level = dutyToLevel(duty, reverse);
+    uint32_t lockState = spin_lock_blocking(motorLock);
+    rightLevel = level;
+    directions = (reverse ^ flipRight) ? (directions | rightDirectionMask) : (directions & ~rightDirectionMask);
+    commitLevels();
+    spin_unlock(motorLock, lockState);
+}
+
+void Motors::setDuties(int32_t leftDuty, int32_t rightDuty)
+{
+    init();
+
+    bool leftReverse, rightReverse;
+    uint16_t newLeftLevel = dutyToLevel(leftDuty, leftReverse);
+    uint16_t newRightLevel = dutyToLevel(rightDuty, rightReverse);
+    uint32_t lockState = spin_lock_blocking(motorLock);
+    leftLevel = newLeftLevel;
+    rightLevel = newRightLevel;
+    directions = ((leftReverse ^ flipLeft) ? leftDirectionMask : 0) |
+                 ((rightReverse ^ flipRight) ? rightDirectionMask : 0);
+    commitLevels();
+    spin_unlock(motorLock, lockState);
+}
+
+void Motors::setLeftSpeed(int16_t speed)
+{
+    init();
+
+    setLeftDuty(speedToDuty(speed));
+}
+
+void Motors::setRightSpeed(int16_t speed)
+{
+    init();
+
+    setRightDuty(speedToDuty(speed));
 }
 
 void Motors::setSpeeds(int16_t leftSpeed, int16_t rightSpeed)
 {
-    setLeftSpeed(leftSpeed);
-    setRightSpeed(rightSpeed);
+    init();
+
+    setDuties(speedToDuty(leftSpeed), speedToDuty(rightSpeed));
 }
 
 }
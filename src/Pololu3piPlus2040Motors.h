@@ -11,6 +11,9 @@ namespace Pololu3piPlus2040
 {
 
 /// \brief Controls motor speed and direction on the 3pi+ 2040.
+///
+/// The motor PWM signals are generated by programming the RP2040's PWM
+/// peripheral directly, so each update only takes a few register writes.
 class Motors
 {
   public:
@@ -59,8 +62,90 @@ class Motors
     /// \param rightSpeed A number from -400 to 400 representing the speed and
     /// direction of the right motor. Values of -400 or less result in full
     /// speed reverse, and values of 400 or more result in full speed forward.
+    ///
+    /// Both motors change speed at the same instant, at the start of the next
+    /// PWM period.  If either motor changes direction, that motor is turned
+    /// off for one PWM period (50 us) while its direction pin is changed, and
+    /// then both motors start at their new speeds together.
     static void setSpeeds(int16_t leftSpeed, int16_t rightSpeed);
 
+    /// \brief Returns the duty cycle value that corresponds to full speed.
+    ///
+    /// The motors are driven by a 20 kHz PWM signal generated directly from
+    /// the RP2040's system clock, so the duty cycle can be set in steps of a
+    /// single clock cycle.  With the default 125 MHz system clock, this
+    /// returns 6250.
+    static uint16_t getMaxDuty();
+
+    /// \brief Sets the duty cycle for the left motor at full resolution.
+    ///
+    /// \param duty A number from -getMaxDuty() to getMaxDuty() representing
+    /// the duty cycle and direction of the left motor.  Values outside of
+    /// this range result in full speed.
+    ///
+    /// This is like setLeftSpeed() but gives finer control of the speed,
+    /// which helps closed-loop speed controllers settle without hunting
+    /// between neighboring speeds.
+    static void setLeftDuty(int32_t duty);
+
+    /// \brief Sets the duty cycle for the right motor at full resolution.
+    ///
+    /// \sa setLeftDuty()
+    static void setRightDuty(int32_t duty);
+
+    /// \brief Sets the duty cycles for both motors at full resolution.
+    ///
+    /// \param leftDuty The duty cycle for the left motor, as for
+    /// setLeftDuty().
+    /// \param rightDuty The duty cycle for the right motor, as for
+    /// setRightDuty().
+    ///
+    /// Both motors are updated together, like setSpeeds().
+    static void setDuties(int32_t leftDuty, int32_t rightDuty);
+
+    /// \brief Starts scaling the motor duty cycles to make up for the
+    /// battery voltage.
+    ///
+    /// \param nominalMillivolts The battery voltage, in millivolts, at which
+    /// the duty cycles are used unchanged. The default is 4800, which is
+    /// about what four fresh NiMH cells give under load.
+    ///
+    /// Without compensation, the motors get the same duty cycle whatever
+    /// the battery voltage is, so the robot slows down as the batteries
+    /// drain and the gains of any speed controller effectively change. With
+    /// compensation enabled, each speed or duty cycle passed to this class is
+    /// multiplied by \p nominalMillivolts divided by the filtered battery
+    /// voltage. The result is still limited to full speed, so the motors
+    /// can't go faster than the battery allows. The scaling is applied when
+    /// the speed is set, so set the speeds regularly, for example from your
+    /// control loop.
+    ///
+    /// The battery voltage shares a pin with the line sensor emitters, so it
+    /// is only read by the code that controls them: every call to
+    /// readBatteryMillivolts() passes its reading to
+    /// updateBatteryMillivolts(), as does the SensorService when its battery
+    /// reads are enabled with SensorService::setBatteryPeriod(). Call one of
+    /// them regularly, such as readBatteryMillivolts() every 100 ms from your
+    /// main loop. The duty cycles aren't scaled until the first reading.
+    static void enableBatteryCompensation(uint16_t nominalMillivolts = 4800);
+
+    /// \brief Stops scaling the motor duty cycles for the battery voltage.
+    static void disableBatteryCompensation();
+
+    /// \brief Adds a battery voltage reading to the filtered voltage used
+    /// for compensation.
+    ///
+    /// \param millivolts The battery voltage in millivolts.
+    ///
+    /// This is called automatically by readBatteryMillivolts() and the
+    /// SensorService. Each reading moves the filtered voltage 1/16th of the
+    /// way towards it. Don't call it from more than one place at a time.
+    static void updateBatteryMillivolts(uint16_t millivolts);
+
+    /// \brief Returns the filtered battery voltage used for compensation in
+    /// millivolts, or 0 if it hasn't been read yet.
+    static uint16_t getBatteryMillivolts();
+
   private:
 
     static inline void init()
@@ -0,0 +1,60 @@
+// Copyright (C) Pololu Corporation.  See www.pololu.com for details.
+
+#include <hardware/timer.h>
+#include "Pololu3piPlus2040RobotFrame.h"
+#include "Pololu3piPlus2040Encoders.h"
+#include "Pololu3piPlus2040LightSensors.h"
+
+namespace Pololu3piPlus2040
+{
+
+// Used to read the light sensors for readRobotFrame(). It shares the QTR state machine with every other
+// LightSensors, LineSensors, and BumpSensors object.
+static LightSensors frameLightSensors;
+
+bool readRobotFrame(RobotFrame & frame, LineSensorsReadMode lineMode, IMU * pIMU)
+{
+  bool result = true;
+
+  // Start the light sensors first since the PIO can time them while everything else is read.
+  uint64_t lightTimestamp = time_us_64();
+  bool lightReadStarted = frameLightSensors.beginRead(lineMode);
+
+  frame.encoderTimestamp = time_us_64();
+  Encoders::getCounts(frame.encoderCountsLeft, frame.encoderCountsRight);
+  frame.encoderSampleCount++;
+
+  if (pIMU != NULL)
+  {
+    frame.imuTimestamp = time_us_64();
+    pIMU->read();
+    if (pIMU->getLastError() == 0)
+    {
+      frame.a = pIMU->a;
+      frame.g = pIMU->g;
+      frame.m = pIMU->m;
+      frame.imuReadCount++;
+    }
+    else
+    {
+      result = false;
+    }
+  }
+
+  if (lightReadStarted)
+  {
+    frameLightSensors.finishRead();
+    frame.lightReadings = frameLightSensors.getReadings();
+    frame.lineMode = lineMode;
+    frame.lightTimestamp = lightTimestamp;
+    frame.lightReadCount++;
+  }
+  else
+  {
+    result = false;
+  }
+
+  return result;
+}
+
+}
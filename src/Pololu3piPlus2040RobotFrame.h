@@ -0,0 +1,91 @@
+// Copyright (C) Pololu Corporation.  See www.pololu.com for details.
+
+/// \file Pololu3piPlus2040RobotFrame.h
+
+#pragma once
+
+#include <Arduino.h>
+#include "RP2040QTR.h"
+#include "Pololu3piPlus2040IMU.h"
+#include "Pololu3piPlus2040LineSensors.h"
+
+namespace Pololu3piPlus2040
+{
+
+/// \brief One set of readings from the encoders, light sensors, and IMU,
+/// with the time that each was taken.
+///
+/// A frame is filled in by readRobotFrame() on core0 or by the SensorService
+/// on core1. Each group of readings has its own count and timestamp, in
+/// microseconds since boot as returned by `time_us_64()`, so estimators can
+/// tell how old each reading is and which ones have been updated since the
+/// last frame.
+///
+/// Pass the frame to LightSensors::read(const RobotFrame&) to use the light
+/// sensor readings with the LineSensors and BumpSensors classes and to
+/// IMU::read(const RobotFrame&) for the IMU readings.
+struct RobotFrame
+{
+  /// Raw readings of all of the bump and line sensors, taken together.
+  QTRSensorReadings lightReadings;
+  /// Line sensor emitter mode used for the light sensor readings.
+  LineSensorsReadMode lineMode;
+  /// Number of light sensor reads taken.
+  uint32_t lightReadCount;
+  /// Time that the latest light sensor read started charging the sensors.
+  /// The sensors then discharge for up to the QTR timeout.
+  uint64_t lightTimestamp;
+
+  /// Left encoder count, sampled together with the right one by
+  /// Encoders::getCounts().
+  int32_t encoderCountsLeft;
+  /// Right encoder count, sampled together with the left one by
+  /// Encoders::getCounts().
+  int32_t encoderCountsRight;
+  /// Number of times the encoders have been sampled.
+  uint32_t encoderSampleCount;
+  /// Time that the encoders were last sampled.
+  uint64_t encoderTimestamp;
+
+  /// Raw accelerometer readings.
+  IMU::vector<int16_t> a;
+  /// Raw gyro readings.
+  IMU::vector<int16_t> g;
+  /// Raw magnetometer readings.
+  IMU::vector<int16_t> m;
+  /// Number of IMU reads taken.
+  uint32_t imuReadCount;
+  /// Time that the latest IMU read started.
+  uint64_t imuTimestamp;
+
+  /// Battery voltage in millivolts. Only read by the SensorService.
+  uint16_t batteryMillivolts;
+  /// Number of battery voltage reads taken.
+  uint32_t batteryReadCount;
+  /// Time that the battery voltage was last read.
+  uint64_t batteryTimestamp;
+};
+
+/// \brief Reads the encoders, light sensors, and IMU into a RobotFrame as
+/// close together in time as possible.
+///
+/// \param frame The frame to update. Its counts are incremented, so pass the
+/// same frame each time.
+/// \param lineMode The behavior of the line sensor emitters during the read,
+/// as a member of the ::LineSensorsReadMode enum. The default is
+/// LineSensorsReadMode::On. LineSensorsReadMode::OnAndOff is not supported.
+/// \param pIMU The IMU to read, or NULL to leave the IMU readings unchanged.
+/// The IMU must already have been initialized and configured.
+///
+/// \return True if all of the readings were taken; false if the light
+/// sensors couldn't be read because another read of them is in progress or
+/// \p lineMode isn't supported, or if the IMU couldn't be read.
+///
+/// The light sensor read is started first and the encoders are sampled right
+/// after it. The IMU is then read over I2C while the PIO is timing the light
+/// sensors, so the whole frame takes about as long as a light sensor read on
+/// its own and the readings are typically taken within a few hundred
+/// microseconds of each other.
+bool readRobotFrame(RobotFrame & frame, LineSensorsReadMode lineMode = LineSensorsReadMode::On, IMU * pIMU = NULL);
+
+}
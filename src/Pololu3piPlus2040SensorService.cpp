@@ -0,0 +1,307 @@
+// Copyright (C) Pololu Corporation.  See www.pololu.com for details.
+
+#include <pico/multicore.h>
+#include <hardware/adc.h>
+#include <hardware/i2c.h>
+#include <hardware/sync.h>
+#include <hardware/timer.h>
+#include "Pololu3piPlus2040SensorService.h"
+#include "Pololu3piPlus2040Encoders.h"
+#include "Pololu3piPlus2040Motors.h"
+
+namespace Pololu3piPlus2040
+{
+
+// Pin 26 is shared between the line sensor emitter control and the battery voltage divider.
+static const uint32_t batteryVoltagePin = 26;
+static const uint32_t batteryVoltageAdcInput = batteryVoltagePin - 26;
+
+// The service running on core1, if any.
+static SensorService * volatile pRunningService = NULL;
+
+// Returns the next time that something with the given period should run, skipping any that were missed.
+static uint64_t nextTime(uint64_t last, uint32_t period, uint64_t now)
+{
+  uint64_t next = last + period;
+  return (next > now) ? next : now + period;
+}
+
+bool SensorService::start()
+{
+  if (running)
+  {
+    return true;
+  }
+  if (pRunningService != NULL)
+  {
+    return false;
+  }
+
+  // Set up the encoders and the ADC on core0 so that core1 doesn't race with other code doing the same.
+  Encoders::init();
+  if ((adc_hw->cs & ADC_CS_EN_BITS) == 0)
+  {
+    adc_init();
+  }
+
+  stopRequested = false;
+  pauseRequested = false;
+  paused = false;
+  running = true;
+  pRunningService = this;
+  multicore_launch_core1(core1Entry);
+  return true;
+}
+
+void SensorService::stop()
+{
+  if (!running)
+  {
+    return;
+  }
+
+  // Let core1 finish what it is doing and turn off the emitters before resetting it.
+  stopRequested = true;
+  while (running)
+  {
+  }
+  multicore_reset_core1();
+  pRunningService = NULL;
+}
+
+bool SensorService::getLatestFrame(RobotFrame & frame)
+{
+  while (true)
+  {
+    // An odd sequence number means that core1 is in the middle of updating the frame.
+    uint32_t start = sequence;
+    if (start & 1)
+    {
+      continue;
+    }
+    __dmb();
+    frame = shared;
+    __dmb();
+    if (sequence == start)
+    {
+      return start != 0;
+    }
+  }
+}
+
+void SensorService::pauseForFlashWrite()
+{
+  SensorService * pService = pRunningService;
+  if (pService == NULL || !pService->running)
+  {
+    return;
+  }
+
+  pService->pauseRequested = true;
+  while (!pService->paused && pService->running)
+  {
+  }
+}
+
+void SensorService::resumeAfterFlashWrite()
+{
+  SensorService * pService = pRunningService;
+  if (pService == NULL)
+  {
+    return;
+  }
+
+  pService->pauseRequested = false;
+  while (pService->paused)
+  {
+  }
+}
+
+void SensorService::core1Entry()
+{
+  pRunningService->run();
+}
+
+// Runs from RAM with interrupts disabled so that core1 doesn't touch the flash while it is being written.
+static void __not_in_flash_func(pauseCore1)(volatile bool & pauseRequested, volatile bool & paused)
+{
+  uint32_t interruptState = save_and_disable_interrupts();
+  paused = true;
+  while (pauseRequested)
+  {
+  }
+  paused = false;
+  restore_interrupts(interruptState);
+}
+
+void SensorService::run()
+{
+  uint64_t now = time_us_64();
+  uint64_t nextLight = now;
+  uint64_t nextEncoder = now;
+  uint64_t nextIMU = now;
+  uint64_t nextBattery = now;
+  bool lightReadPending = false;
+
+  while (!stopRequested)
+  {
+    if (pauseRequested)
+    {
+      pauseCore1(pauseRequested, paused);
+    }
+
+    bool updated = false;
+    now = time_us_64();
+
+    // Let the PIO time the light sensors while the other sensors are sampled.
+    if (lightReadPending)
+    {
+      if (pQTR->isReadComplete())
+      {
+        finishLightRead();
+        lightReadPending = false;
+        updated = true;
+      }
+    }
+    else if (lightPeriod != 0 && now >= nextLight)
+    {
+      working.lightTimestamp = now;
+      startLightRead();
+      lightReadPending = true;
+      nextLight = nextTime(nextLight, lightPeriod, now);
+    }
+
+    if (encoderPeriod != 0 && now >= nextEncoder)
+    {
+      Encoders::getCounts(working.encoderCountsLeft, working.encoderCountsRight);
+      working.encoderTimestamp = now;
+      working.encoderSampleCount++;
+      nextEncoder = nextTime(nextEncoder, encoderPeriod, now);
+      updated = true;
+    }
+
+    if (imuPeriod != 0 && now >= nextIMU)
+    {
+      working.imuTimestamp = now;
+      readIMU();
+      nextIMU = nextTime(nextIMU, imuPeriod, now);
+      updated = true;
+    }
+
+    // The battery voltage can only be read while the line sensor emitters are off, between light sensor reads.
+    if (batteryPeriod != 0 && now >= nextBattery && !lightReadPending && lineMode != LineSensorsReadMode::Manual)
+    {
+      working.batteryTimestamp = now;
+      readBattery();
+      nextBattery = nextTime(nextBattery, batteryPeriod, now);
+      updated = true;
+    }
+
+    if (updated)
+    {
+      publish();
+    }
+  }
+
+  if (lightReadPending)
+  {
+    finishLightRead();
+    publish();
+  }
+  running = false;
+}
+
+void SensorService::publish()
+{
+  // Core1 is the only writer so the sequence number can simply be incremented around the update.
+  sequence = sequence + 1;
+  __dmb();
+  shared = working;
+  __dmb();
+  sequence = sequence + 1;
+}
+
+void SensorService::startLightRead()
+{
+  pendingLineMode = lineMode;
+
+  // Pin 26 is shared with the analog battery voltage so use init() to make sure that the SIO function has been
+  // reselected for the pin. This matches LightSensors::beginRead().
+  switch (pendingLineMode)
+  {
+    case LineSensorsReadMode::On:
+      lineEmitterPin.init(true, true, false, false);
+      break;
+
+    case LineSensorsReadMode::Manual:
+      break;
+
+    default: // Off, or OnAndOff which isn't supported
+      lineEmitterPin.init(false, false, false, false);
+      break;
+  }
+  bumpEmitterPin.setOutputHigh();
+  pQTR->startRead(QTRSensors::ALL_SENSORS_MASK);
+}
+
+void SensorService::finishLightRead()
+{
+  working.lightReadings = pQTR->finishRead();
+  emittersOff();
+  working.lineMode = (pendingLineMode == LineSensorsReadMode::OnAndOff) ? LineSensorsReadMode::Off : pendingLineMode;
+  working.lightReadCount++;
+}
+
+void SensorService::readBattery()
+{
+  // Switch the pin over to the ADC like analogRead() does. startLightRead() reselects the SIO function for the
+  // emitters.
+  adc_gpio_init(batteryVoltagePin);
+  adc_select_input(batteryVoltageAdcInput);
+  uint32_t reading = adc_read();
+
+  // The voltage divider steps the voltage down by 1/11th of the actual battery voltage and the ADC readings fall in
+  // a 12-bit range.
+  working.batteryMillivolts = (3300 * 11 * reading + 2047) / 4095;
+  working.batteryReadCount++;
+  Motors::updateBatteryMillivolts(working.batteryMillivolts);
+}
+
+void SensorService::emittersOff()
+{
+  bumpEmitterPin.setInput();
+  if (pendingLineMode != LineSensorsReadMode::Manual)
+  {
+    lineEmitterPin.init(false, false, false, false);
+  }
+}
+
+void SensorService::readIMU()
+{
+  // The Wire library isn't safe to use from core1 so talk to the I2C peripheral that it set up directly. The
+  // register auto-increment settings are the same ones that IMU::read() relies on.
+  if (readIMUAxes(LSM6DSO_ADDR, LSM6DSO_REG_OUTX_L_XL, working.a) &&
+      readIMUAxes(LSM6DSO_ADDR, LSM6DSO_REG_OUTX_L_G, working.g) &&
+      readIMUAxes(LIS3MDL_ADDR, LIS3MDL_REG_OUT_X_L | (1 << 7), working.m))
+  {
+    working.imuReadCount++;
+  }
+}
+
+bool SensorService::readIMUAxes(uint8_t addr, uint8_t firstReg, IMU::vector<int16_t> & v)
+{
+  uint8_t buffer[6];
+  if (i2c_write_blocking(i2c0, addr, &firstReg, 1, true) != 1 ||
+      i2c_read_blocking(i2c0, addr, buffer, sizeof(buffer), false) != sizeof(buffer))
+  {
+    return false;
+  }
+
+  // combine bytes
+  v.x = (int16_t)(buffer[1] << 8 | buffer[0]);
+  v.y = (int16_t)(buffer[3] << 8 | buffer[2]);
+  v.z = (int16_t)(buffer[5] << 8 | buffer[4]);
+  return true;
+}
+
+}
@@ -0,0 +1,191 @@
+// Copyright (C) Pololu Corporation.  See www.pololu.com for details.
+
+/// \file Pololu3piPlus2040SensorService.h
+
+#pragma once
+
+#include <Arduino.h>
+#include "RP2040SIO.h"
+#include "RP2040QTR.h"
+#include "Pololu3piPlus2040RobotFrame.h"
+
+namespace Pololu3piPlus2040
+{
+
+/// \brief Reads the sensors at fixed rates on the RP2040's second core.
+///
+/// Everything else in this library runs on the first core (core0), which
+/// leaves the second core (core1) idle. Once start() is called, this class
+/// uses core1 to read the light sensors, sample the encoders, and poll the
+/// IMU, each at its own rate, and publishes the results as a RobotFrame. Your
+/// control loop on core0 then only needs to call getLatestFrame() to get the
+/// latest readings, which never waits on the sensors.
+///
+/// The frame is handed over with a sequence lock: core1 bumps a sequence
+/// number before and after updating it, and getLatestFrame() simply copies
+/// it again in the rare case that the copy overlapped an update. Neither core
+/// ever waits for the other to release a lock.
+///
+/// Pass the frame to LightSensors::read(const RobotFrame&) to use the light
+/// sensor readings with the LineSensors and BumpSensors classes and to
+/// IMU::read(const RobotFrame&) for the IMU readings.
+///
+/// While the service is running, core0 must not read the light sensors
+/// itself (such as with LineSensors::read()) or the battery voltage (such as
+/// with readBatteryMillivolts()) or, if IMU polling is enabled, use the I2C
+/// bus. If battery reads are enabled, core0 must not use the ADC either. The settings can be changed at any time and take effect
+/// from the next reading.
+///
+/// Example usage:
+/// ~~~{.cpp}
+/// sensorService.start();
+/// ...
+/// RobotFrame frame;
+/// if (sensorService.getLatestFrame(frame))
+/// {
+///   lightSensors.read(frame);
+///   uint16_t position = lineSensors.readLineBlack(lightSensors);
+/// }
+/// ~~~
+class SensorService
+{
+  private:
+    RP2040SIO::Pin<23> bumpEmitterPin;
+    RP2040SIO::Pin<26> lineEmitterPin;
+
+  public:
+    SensorService()
+    {
+      pQTR = QTRSensors::getSharedQTR();
+      memset(&shared, 0, sizeof(shared));
+      memset(&working, 0, sizeof(working));
+    }
+
+    /// \brief Sets how often the light sensors are read.
+    ///
+    /// \param periodUs The time between the start of each read in
+    /// microseconds, or 0 to not read the light sensors. The default is 1000.
+    ///
+    /// All seven bump and line sensors are read together with the bump
+    /// sensor emitters on, like LightSensors::read(). If a read takes longer
+    /// than the period, the next one starts as soon as it is done.
+    void setLightSensorPeriod(uint32_t periodUs) { lightPeriod = periodUs; }
+
+    /// \brief Sets the line sensor emitter behavior for the light sensor
+    /// reads.
+    ///
+    /// \param mode A member of the ::LineSensorsReadMode enum. The default is
+    /// LineSensorsReadMode::On. LineSensorsReadMode::OnAndOff is not
+    /// supported.
+    void setLineMode(LineSensorsReadMode mode) { lineMode = mode; }
+
+    /// \brief Sets how often the encoder counts are sampled.
+    ///
+    /// \param periodUs The time between samples in microseconds, or 0 to not
+    /// sample the encoders. The default is 1000.
+    void setEncoderPeriod(uint32_t periodUs) { encoderPeriod = periodUs; }
+
+    /// \brief Sets how often the IMU is read.
+    ///
+    /// \param periodUs The time between reads in microseconds, or 0 to not
+    /// read the IMU. The default is 0.
+    ///
+    /// The IMU must already be initialized and configured on core0 (for
+    /// example with `Wire.begin()`, IMU::init(), and IMU::enableDefault())
+    /// before start() is called. The accelerometer, gyro, and magnetometer
+    /// are all read each time.
+    void setIMUPeriod(uint32_t periodUs) { imuPeriod = periodUs; }
+
+    /// \brief Sets how often the battery voltage is read.
+    ///
+    /// \param periodUs The time between reads in microseconds, or 0 to not
+    /// read the battery voltage. The default is 0.
+    ///
+    /// The battery voltage shares a pin with the line sensor emitters, which
+    /// core1 controls while the service is running, so it is read on core1
+    /// between light sensor reads while the emitters are off. Each reading is
+    /// stored in the frame and passed to Motors::updateBatteryMillivolts()
+    /// for battery compensation. The battery isn't read while the line mode
+    /// is LineSensorsReadMode::Manual, since the emitters could be on.
+    void setBatteryPeriod(uint32_t periodUs) { batteryPeriod = periodUs; }
+
+    /// \brief Starts reading the sensors on core1.
+    ///
+    /// \return True if the service is running; false if another
+    /// SensorService is already using core1.
+    bool start();
+
+    /// \brief Stops reading the sensors and resets core1.
+    ///
+    /// Any read in progress is completed first and the emitters are turned
+    /// off. The last frame stays available from getLatestFrame().
+    void stop();
+
+    /// \brief Returns true if the service is running on core1.
+    bool isRunning() { return running; }
+
+    /// \brief Gets the latest readings.
+    ///
+    /// \param frame Receives a consistent copy of the latest readings.
+    ///
+    /// \return True if any readings have been taken; false otherwise.
+    ///
+    /// This never waits on the sensors or on core1. It can be called as
+    /// often as you like.
+    bool getLatestFrame(RobotFrame & frame);
+
+    /// \brief Returns a number which changes each time new readings are
+    /// published.
+    ///
+    /// This can be used to check for new readings without copying the
+    /// frame.
+    uint32_t getSequence() { return sequence; }
+
+    /// \brief Pauses core1 while the flash is being written.
+    ///
+    /// Core1 runs code from flash, which isn't possible while it is being
+    /// erased or programmed. CalibrationStorage calls this for you. Each call
+    /// must be matched with a call to resumeAfterFlashWrite().
+    static void pauseForFlashWrite();
+
+    /// \brief Resumes core1 after pauseForFlashWrite().
+    static void resumeAfterFlashWrite();
+
+  private:
+    /// Pointer to the QTR sensor reading singleton shared with the line and
+    /// bump sensors.
+    QTRSensors* pQTR;
+
+    volatile uint32_t lightPeriod = 1000;
+    volatile uint32_t encoderPeriod = 1000;
+    volatile uint32_t imuPeriod = 0;
+    volatile uint32_t batteryPeriod = 0;
+    volatile LineSensorsReadMode lineMode = LineSensorsReadMode::On;
+    /// Line emitter mode of the light sensor read in progress.
+    LineSensorsReadMode pendingLineMode = LineSensorsReadMode::On;
+
+    /// Readings published to core0. Only valid while sequence is even.
+    RobotFrame shared;
+    /// Incremented before and after each update of shared.
+    volatile uint32_t sequence = 0;
+
+    /// Readings being gathered on core1.
+    RobotFrame working;
+
+    volatile bool running = false;
+    volatile bool stopRequested = false;
+    volatile bool pauseRequested = false;
+    volatile bool paused = false;
+
+    static void core1Entry();
+    void run();
+    void publish();
+    void startLightRead();
+    void finishLightRead();
+    void emittersOff();
+    void readBattery();
+    void readIMU();
+    bool readIMUAxes(uint8_t addr, uint8_t firstReg, IMU::vector<int16_t> & v);
+};
+
+}
@@ -0,0 +1,206 @@
+// Copyright (C) Pololu Corporation.  See www.pololu.com for details.
+
+#include <math.h>
+#include <string.h>
+#include <hardware/timer.h>
+#include "Pololu3piPlus2040WheelSpeedController.h"
+#include "Pololu3piPlus2040Encoders.h"
+#include "Pololu3piPlus2040Motors.h"
+
+namespace Pololu3piPlus2040
+{
+
+// The controller running from each hardware alarm, if any.
+static WheelSpeedController * pAlarmControllers[4] = { NULL, NULL, NULL, NULL };
+
+// Converts a gain to 16.16 fixed-point, rounding to the nearest step. Gains too big for 16.16 are clamped to the
+// biggest one and gains too small for it are kept at the smallest one rather than turning into 0.
+static int32_t toFixed(float value)
+{
+  float scaled = value * 65536.0f;
+  if (scaled >= 2147483648.0f)
+  {
+    return INT32_MAX;
+  }
+  if (scaled <= -2147483648.0f)
+  {
+    return -INT32_MAX;
+  }
+  int32_t fixed = (int32_t)lroundf(scaled);
+  if (fixed == 0 && value != 0)
+  {
+    fixed = (value > 0) ? 1 : -1;
+  }
+  return fixed;
+}
+
+WheelSpeedController::WheelSpeedController()
+{
+  memset(&left, 0, sizeof(left));
+  memset(&right, 0, sizeof(right));
+  ki = 0;
+  kd = 0;
+  period = 1000;
+  nextUpdateTime = 0;
+  alarmNum = -1;
+  running = false;
+  setCountsPerMillimeter(358.3f / (32.0f * 3.14159265f));
+  setGains(0.5f, 10.0f, 0.0f);
+}
+
+void WheelSpeedController::setGains(float newKp, float newKi, float newKd)
+{
+  kp = toFixed(newKp);
+  ki = newKi;
+  kd = newKd;
+  updateScaledGains();
+}
+
+// The integral and derivative gains are scaled by the update period before they are converted, so their limits
+// depend on the period as well as on 16.16 fixed-point. See setGains().
+void WheelSpeedController::updateScaledGains()
+{
+  kiPerUpdate = toFixed(ki * period / 1000000.0f);
+  kdPerUpdate = toFixed(kd * 1000000.0f / period);
+}
+
+void WheelSpeedController::setCountsPerMillimeter(float c)
+{
+  countsPerMillimeter = c;
+}
+
+void WheelSpeedController::setTargetCountsPerSecond(int32_t leftTarget, int32_t rightTarget)
+{
+  left.target = leftTarget;
+  right.target = rightTarget;
+}
+
+void WheelSpeedController::setTargetMillimetersPerSecond(float leftTarget, float rightTarget)
+{
+  setTargetCountsPerSecond((int32_t)(leftTarget * countsPerMillimeter), (int32_t)(rightTarget * countsPerMillimeter));
+}
+
+bool WheelSpeedController::start(uint32_t periodUs)
+{
+  if (running)
+  {
+    return true;
+  }
+
+  int32_t alarm = hardware_alarm_claim_unused(false);
+  if (alarm < 0)
+  {
+    return false;
+  }
+
+  // Set up the encoders and motors here so that it doesn't happen in the interrupt.
+  Encoders::init();
+  Encoders::getCountsPerSecondLeft();
+  Encoders::getCountsPerSecondRight();
+  Motors::setDuties(0, 0);
+
+  period = periodUs;
+  updateScaledGains();
+  left.integral = 0;
+  left.lastMeasured = 0;
+  right.integral = 0;
+  right.lastMeasured = 0;
+
+  alarmNum = alarm;
+  pAlarmControllers[alarmNum] = this;
+  running = true;
+  hardware_alarm_set_callback(alarmNum, alarmCallback);
+  nextUpdateTime = time_us_64() + period;
+  hardware_alarm_set_target(alarmNum, from_us_since_boot(nextUpdateTime));
+  return true;
+}
+
+void WheelSpeedController::stop()
+{
+  if (!running)
+  {
+    return;
+  }
+
+  // The callback doesn't schedule another update once running is cleared.
+  running = false;
+  hardware_alarm_cancel(alarmNum);
+  hardware_alarm_set_callback(alarmNum, NULL);
+  hardware_alarm_unclaim(alarmNum);
+  pAlarmControllers[alarmNum] = NULL;
+  alarmNum = -1;
+
+  Motors::setDuties(0, 0);
+}
+
+void WheelSpeedController::alarmCallback(unsigned int alarm)
+{
+  WheelSpeedController * pController = pAlarmControllers[alarm];
+  if (pController == NULL || !pController->running)
+  {
+    return;
+  }
+
+  pController->update();
+
+  // Schedule the next update, skipping any that have already been missed.
+  do
+  {
+    pController->nextUpdateTime += pController->period;
+  }
+  while (hardware_alarm_set_target(alarm, from_us_since_boot(pController->nextUpdateTime)));
+}
+
+void WheelSpeedController::update()
+{
+  int32_t leftDuty = updateWheel(left, Encoders::getCountsPerSecondLeft());
+  int32_t rightDuty = updateWheel(right, Encoders::getCountsPerSecondRight());
+  Motors::setDuties(leftDuty, rightDuty);
+}
+
+int32_t WheelSpeedController::updateWheel(Wheel & wheel, int32_t measured)
+{
+  int32_t error = wheel.target - measured;
+  int64_t limit = (int64_t)Motors::getMaxDuty() << 16;
+
+  // Take the derivative of the measurement instead of the error so that changing the target doesn't kick the
+  // motors.
+  int64_t proportional = (int64_t)kp * error;
+  int64_t derivative = -(int64_t)kdPerUpdate * (measured - wheel.lastMeasured);
+  int64_t integral = wheel.integral + (int64_t)kiPerUpdate * error;
+  if (integral > limit)
+  {
+    integral = limit;
+  }
+  else if (integral < -limit)
+  {
+    integral = -limit;
+  }
+
+  // Only let the integral grow while the output isn't saturated in the same direction, so it doesn't wind up while
+  // the motors can't keep up.
+  int64_t output = proportional + integral + derivative;
+  if (output > limit)
+  {
+    output = limit;
+    if (error > 0 && integral > wheel.integral)
+    {
+      integral = wheel.integral;
+    }
+  }
+  else if (output < -limit)
+  {
+    output = -limit;
+    if (error < 0 && integral < wheel.integral)
+    {
+      integral = wheel.integral;
+    }
+  }
+
+  wheel.integral = integral;
+  wheel.lastMeasured = measured;
+  wheel.measured = measured;
+  return (int32_t)(output >> 16);
+}
+
+}
@@ -0,0 +1,163 @@
+// Copyright (C) Pololu Corporation.  See www.pololu.com for details.
+
+/// \file Pololu3piPlus2040WheelSpeedController.h
+
+#pragma once
+
+#include <stdint.h>
+
+namespace Pololu3piPlus2040
+{
+
+/// \brief Holds the speed of each wheel at a target using the encoders and
+/// a PID controller.
+///
+/// Once start() is called, this class reads the speed of each wheel from
+/// the Encoders class at a fixed rate from an RP2040 hardware timer
+/// interrupt and sets the motor duty cycles with Motors::setDuties() to keep
+/// each wheel at its target speed. The rate stays the same no matter what
+/// the rest of your code is doing, so your sketch only needs to call
+/// setTargetCountsPerSecond() or setTargetMillimetersPerSecond() whenever it
+/// wants the robot to move differently.
+///
+/// Each wheel has its own proportional, integral, and derivative (PID)
+/// controller, calculated in fixed-point so that it doesn't take long in
+/// the interrupt. The integral term is limited so that it doesn't wind up
+/// while the motors are saturated, which would otherwise cause a large
+/// overshoot when the robot is held back and then released.
+///
+/// While the controller is running, your code should not set the motor
+/// speeds itself or call Encoders::getCountsPerSecondLeft() or
+/// Encoders::getCountsPerSecondRight(), which the controller uses, or
+/// Encoders::getVelocityLeft() or Encoders::getVelocityRight(), which share
+/// their edge history. The measured
+/// speeds are available from getMeasuredCountsPerSecondLeft() and
+/// getMeasuredCountsPerSecondRight() instead.
+///
+/// Example usage:
+/// ~~~{.cpp}
+/// WheelSpeedController speedController;
+///
+/// void setup()
+/// {
+///   speedController.start();
+/// }
+///
+/// void loop()
+/// {
+///   speedController.setTargetMillimetersPerSecond(300, 300);
+///   ...
+/// }
+/// ~~~
+class WheelSpeedController
+{
+  public:
+    WheelSpeedController();
+
+    /// \brief Sets the gains for both wheels' PID controllers.
+    ///
+    /// \param kp The proportional gain, in duty cycle units (see
+    /// Motors::getMaxDuty()) per count per second of speed error. The
+    /// default is 0.5.
+    /// \param ki The integral gain, in duty cycle units per count of
+    /// accumulated error. The default is 10.
+    /// \param kd The derivative gain, in duty cycle units per count per
+    /// second squared of change in the measured speed. The default is 0.
+    ///
+    /// The gains are converted to 16.16 fixed-point numbers, rounded to the
+    /// nearest step. They can be changed at any time.
+    ///
+    /// kp can range from about 0.00002 to 32767. ki and kd are scaled by the
+    /// update period passed to start() before they are converted, so their
+    /// limits depend on it. ki is multiplied by the period in seconds, so it
+    /// must be at least about 0.0153 at the default period of 1000 us, and
+    /// proportionally less at longer periods. kd is divided by the period
+    /// in seconds, so it must be less than about 32.77 at the default
+    /// period, and proportionally more at longer periods. Gains outside
+    /// these limits are clamped to them, and a non-zero gain never becomes
+    /// 0.
+    void setGains(float kp, float ki, float kd);
+
+    /// \brief Sets the number of encoder counts per millimeter of travel,
+    /// used by setTargetMillimetersPerSecond().
+    ///
+    /// The default of 3.564 is for the standard edition 3pi+ 2040, which has
+    /// 30:1 gear motors (358.3 counts per wheel revolution) and 32 mm
+    /// wheels. Use 1.782 for the hyper edition (15:1) and 8.913 for the
+    /// turtle edition (75:1).
+    void setCountsPerMillimeter(float countsPerMillimeter);
+
+    /// \brief Sets the target speeds of the wheels in encoder counts per
+    /// second.
+    ///
+    /// Positive speeds correspond to forward movement, like the counts from
+    /// the Encoders class.
+    void setTargetCountsPerSecond(int32_t left, int32_t right);
+
+    /// \brief Sets the target speeds of the wheels in millimeters per
+    /// second.
+    ///
+    /// \sa setCountsPerMillimeter()
+    void setTargetMillimetersPerSecond(float left, float right);
+
+    /// \brief Starts controlling the wheel speeds.
+    ///
+    /// \param periodUs The time between updates of the controller in
+    /// microseconds. The default is 1000.
+    ///
+    /// \return True if the controller is running; false if there was no
+    /// free hardware alarm to run it with.
+    ///
+    /// The timer interrupt runs on the core that calls this function.
+    bool start(uint32_t periodUs = 1000);
+
+    /// \brief Stops controlling the wheel speeds and stops the motors.
+    void stop();
+
+    /// \brief Returns true if the controller is running.
+    bool isRunning() { return running; }
+
+    /// \brief Returns the left wheel speed measured at the latest update in
+    /// counts per second.
+    int32_t getMeasuredCountsPerSecondLeft() { return left.measured; }
+
+    /// \brief Returns the right wheel speed measured at the latest update in
+    /// counts per second.
+    int32_t getMeasuredCountsPerSecondRight() { return right.measured; }
+
+  private:
+    /// State of the PID controller for one wheel.
+    struct Wheel
+    {
+      volatile int32_t target;
+      volatile int32_t measured;
+      /// Measured speed at the update before the latest one.
+      int32_t lastMeasured;
+      /// Integral term in 16.16 fixed-point duty cycle units.
+      int64_t integral;
+    };
+
+    Wheel left;
+    Wheel right;
+
+    /// Gains in 16.16 fixed-point, with the integral and derivative gains
+    /// scaled by the update period.
+    volatile int32_t kp;
+    volatile int32_t kiPerUpdate;
+    volatile int32_t kdPerUpdate;
+    float ki;
+    float kd;
+    float countsPerMillimeter;
+
+    uint32_t period;
+    uint64_t nextUpdateTime;
+    int32_t alarmNum;
+    volatile bool running;
+
+    static void alarmCallback(unsigned int alarmNum);
+    void updateScaledGains();
+    void update();
+    int32_t updateWheel(Wheel & wheel, int32_t measured);
+};
+
+}
@@ -0,0 +1,333 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Class to use a single RP2040 PIO state machine to count the ticks of two quadrature encoders and time the edges.
+#include <string.h>
+#include <hardware/irq.h>
+#include "RP2040DualEncoders.h"
+#include "RP2040DualEncoders.pio.h"
+
+
+// The object which handles the DMA interrupts.
+static RP2040DualEncoders* g_pDualEncoders = NULL;
+
+// Change in count for each transition, indexed by the previous 2-bit state of the encoder pins and then the current
+// one. Transitions that change both pins at once can't be decoded so they don't change the count and are counted as
+// illegal transitions instead.
+static const int8_t g_quadratureDeltas[16] =
+{
+//  00  01  10  11  <- current
+     0,  1, -1,  0, // 00 previous
+    -1,  0,  0,  1, // 01
+     1,  0,  0, -1, // 10
+     0, -1,  1,  0  // 11
+};
+
+
+RP2040DualEncoders::RP2040DualEncoders()
+{
+    m_pio = pio0;
+    m_stateMachine = -1;
+    m_dmaChannel = 0;
+    m_dmaControlChannel = 0;
+    m_dmaTransferCount = 1;
+    m_eventReadIndex = 0;
+    m_havePins = false;
+    m_pins = 0;
+    m_passes = 0;
+    m_cycles = 0;
+    memset(m_counts, 0, sizeof(m_counts));
+    memset(m_edgeCycles, 0, sizeof(m_edgeCycles));
+    m_generation = 0;
+    for (uint32_t i = 0 ; i < 2 ; i++)
+    {
+        m_publishedCounts[i] = 0;
+        m_publishedPositions[i] = 0;
+        m_publishedEdgeCycles[i] = 0;
+        m_illegalTransitions[i] = 0;
+    }
+    m_eventOverruns = 0;
+    for (uint32_t i = 0 ; i < eventRingSize ; i++)
+    {
+        m_eventRing[i] = decodedEvent;
+    }
+}
+
+bool RP2040DualEncoders::init(uint32_t pinBase)
+{
+    if (g_pDualEncoders != NULL)
+    {
+        return false;
+    }
+
+    // Make sure that there is enough room to load this program into one of the PIO instances.
+    m_pio = pio0;
+    if (!pio_can_add_program(m_pio, &RP2040DualEncoders_program) )
+    {
+        m_pio = pio1;
+        if (!pio_can_add_program(m_pio, &RP2040DualEncoders_program) )
+        {
+            return false;
+        }
+    }
+
+    int32_t stateMachine = pio_claim_unused_sm(m_pio, false);
+    if (stateMachine < 0)
+    {
+        return false;
+    }
+    int dmaChannel = dma_claim_unused_channel(false);
+    int dmaControlChannel = dma_claim_unused_channel(false);
+    if (dmaChannel < 0 || dmaControlChannel < 0)
+    {
+        // Release what was claimed and return a failure code.
+        if (dmaChannel >= 0)
+        {
+            dma_channel_unclaim(dmaChannel);
+        }
+        if (dmaControlChannel >= 0)
+        {
+            dma_channel_unclaim(dmaControlChannel);
+        }
+        pio_sm_unclaim(m_pio, stateMachine);
+        return false;
+    }
+    m_stateMachine = stateMachine;
+    m_dmaChannel = dmaChannel;
+    m_dmaControlChannel = dmaControlChannel;
+
+    uint programOffset = pio_add_program(m_pio, &RP2040DualEncoders_program);
+    pio_sm_config smConfig = RP2040DualEncoders_program_get_default_config(programOffset);
+
+    // Configure the state machine to run the dual quadrature encoder program.
+    const bool shiftLeft = false;
+    const bool noAutoPush = false;
+    const uint threshhold = 32;
+    // We want the ISR to shift to the left so that the pin states end up in the upper bits of each event.
+    sm_config_set_in_shift(&smConfig, shiftLeft, noAutoPush, threshhold);
+    sm_config_set_in_pins(&smConfig, pinBase);
+    // Use the TX FIFO entries for RX since we don't use the TX path. This makes for an 8 element RX FIFO.
+    sm_config_set_fifo_join(&smConfig, PIO_FIFO_JOIN_RX);
+    pio_sm_init(m_pio, m_stateMachine, programOffset + RP2040DualEncoders_offset_start, &smConfig);
+
+    // The control channel restarts the data channel each time it finishes its transfers, so the events keep flowing
+    // forever. The data channel's write address isn't reloaded when it is restarted so it just carries on around the
+    // ring.
+    dma_channel_config controlConfig = dma_channel_get_default_config(m_dmaControlChannel);
+    channel_config_set_read_increment(&controlConfig, false);
+    channel_config_set_write_increment(&controlConfig, false);
+    dma_channel_configure(m_dmaControlChannel, &controlConfig,
+        &dma_channel_hw_addr(m_dmaChannel)->al1_transfer_count_trig,    // Destination pointer
+        &m_dmaTransferCount,            // Source pointer
+        1,                  // Just rewrite the transfer count
+        false               // Wait to be chained to
+    );
+
+    // Configure DMA to copy each event from the state machine's RX FIFO into the event ring buffer. It interrupts
+    // after every event so that the counts are published as soon as they change. The ring only fills up if that
+    // interrupt is held off for eventRingSize events.
+    dma_channel_config dmaConfig = dma_channel_get_default_config(m_dmaChannel);
+    channel_config_set_read_increment(&dmaConfig, false);
+    channel_config_set_write_increment(&dmaConfig, true);
+    channel_config_set_ring(&dmaConfig, true, __builtin_ctz(sizeof(m_eventRing)));
+    channel_config_set_dreq(&dmaConfig, pio_get_dreq(m_pio, m_stateMachine, false));
+    channel_config_set_chain_to(&dmaConfig, m_dmaControlChannel);
+    dma_channel_configure(m_dmaChannel, &dmaConfig,
+        m_eventRing,                    // Destination pointer
+        &m_pio->rxf[m_stateMachine],    // Source pointer
+        m_dmaTransferCount,             // One event at a time
+        true                // Start immediately
+    );
+
+    g_pDualEncoders = this;
+    dma_channel_set_irq0_enabled(m_dmaChannel, true);
+    irq_add_shared_handler(DMA_IRQ_0, dmaInterruptHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    // Initialize state machine registers.
+    // Initialize the Y register to a value that can't match the pins so that the initial pin states are pushed.
+    pio_sm_exec(m_pio, m_stateMachine, pio_encode_mov_not(pio_y, pio_null));
+    // Initialize the pass counter in the OSR register.
+    pio_sm_exec(m_pio, m_stateMachine, pio_encode_mov_not(pio_osr, pio_null));
+
+    // Now start the state machine to watch the encoder pins.
+    pio_sm_set_enabled(m_pio, m_stateMachine, true);
+
+    return true;
+}
+
+int32_t RP2040DualEncoders::getCount(int32_t index)
+{
+    hard_assert ( index >= 0 && index < (int32_t)(sizeof(m_counts)/sizeof(m_counts[0])) );
+    return m_publishedCounts[index];
+}
+
+void RP2040DualEncoders::getCounts(int32_t& count0, int32_t& count1)
+{
+    int64_t positions[2];
+    uint32_t edgeCycles[2];
+    readPublished(positions, edgeCycles);
+    count0 = (int32_t)positions[0];
+    count1 = (int32_t)positions[1];
+}
+
+void RP2040DualEncoders::getPositions(int64_t& position0, int64_t& position1)
+{
+    int64_t positions[2];
+    uint32_t edgeCycles[2];
+    readPublished(positions, edgeCycles);
+    position0 = positions[0];
+    position1 = positions[1];
+}
+
+void RP2040DualEncoders::getLatestEdge(int32_t index, int32_t& count, uint32_t& cycles)
+{
+    hard_assert ( index >= 0 && index < (int32_t)(sizeof(m_counts)/sizeof(m_counts[0])) );
+    int64_t positions[2];
+    uint32_t edgeCycles[2];
+    readPublished(positions, edgeCycles);
+    count = (int32_t)positions[index];
+    cycles = edgeCycles[index];
+}
+
+uint32_t RP2040DualEncoders::getIllegalTransitions(int32_t index)
+{
+    hard_assert ( index >= 0 && index < (int32_t)(sizeof(m_counts)/sizeof(m_counts[0])) );
+    return m_illegalTransitions[index];
+}
+
+uint32_t RP2040DualEncoders::getEventOverruns()
+{
+    return m_eventOverruns;
+}
+
+void RP2040DualEncoders::readPublished(int64_t positions[2], uint32_t edgeCycles[2])
+{
+    while (true)
+    {
+        // An odd generation means that the DMA interrupt on the other core is in the middle of publishing.
+        uint32_t generation = m_generation;
+        if (generation & 1)
+        {
+            continue;
+        }
+        __dmb();
+        for (uint32_t i = 0 ; i < 2 ; i++)
+        {
+            positions[i] = m_publishedPositions[i];
+            edgeCycles[i] = m_publishedEdgeCycles[i];
+        }
+        __dmb();
+        if (m_generation == generation)
+        {
+            return;
+        }
+    }
+}
+
+void RP2040DualEncoders::dmaInterruptHandler()
+{
+    RP2040DualEncoders* pThis = g_pDualEncoders;
+    if (pThis == NULL || !dma_channel_get_irq0_status(pThis->m_dmaChannel))
+    {
+        return;
+    }
+    dma_channel_acknowledge_irq0(pThis->m_dmaChannel);
+
+    pThis->decodeEvents();
+    pThis->publish();
+}
+
+void RP2040DualEncoders::publish()
+{
+    // Higher priority interrupts on this core are held off while publishing so that they can't spin forever waiting
+    // for the generation to become even again.
+    uint32_t interruptState = save_and_disable_interrupts();
+    m_generation++;
+    __dmb();
+    for (uint32_t i = 0 ; i < 2 ; i++)
+    {
+        m_publishedPositions[i] = m_counts[i];
+        m_publishedEdgeCycles[i] = m_edgeCycles[i];
+        m_publishedCounts[i] = (int32_t)m_counts[i];
+    }
+    __dmb();
+    m_generation++;
+    restore_interrupts(interruptState);
+}
+
+void RP2040DualEncoders::decodeEvents()
+{
+    uint32_t writeIndex = dmaEventWriteIndex();
+    uint32_t eventCount = (writeIndex - m_eventReadIndex) & (eventRingSize - 1);
+
+    // Decoded events are cleared from the ring so the slot that the DMA channel writes next only holds an event if
+    // the channel has gone all the way around the ring since the last decode. The read and write indices match then,
+    // just as they do when there are no new events. The write index is read again to make sure that the DMA channel
+    // didn't just write that slot, in which case it is a new event that will be decoded next time. When the ring has
+    // overrun, its oldest event is in the slot that is written next so all of the events are decoded from there.
+    if (m_eventRing[writeIndex] != decodedEvent && dmaEventWriteIndex() == writeIndex)
+    {
+        m_eventOverruns++;
+        m_eventReadIndex = writeIndex;
+        eventCount = eventRingSize;
+    }
+
+    while (eventCount-- > 0)
+    {
+        uint32_t event = m_eventRing[m_eventReadIndex];
+        m_eventRing[m_eventReadIndex] = decodedEvent;
+        m_eventReadIndex = (m_eventReadIndex + 1) & (eventRingSize - 1);
+
+        // The PIO counts the passes down.
+        uint32_t pins = event >> 26;
+        uint32_t passes = ~event & passMask;
+        if (!m_havePins)
+        {
+            // The first event just holds the initial pin states.
+            m_havePins = true;
+            m_pins = pins;
+            m_passes = passes;
+            continue;
+        }
+
+        // Every pass takes CYCLES_PER_PASS cycles and the ones that push an event take a few more.
+        m_cycles += ((passes - m_passes) & passMask) * CYCLES_PER_PASS + EXTRA_CYCLES_PER_EVENT;
+        m_passes = passes;
+
+        // Encoder 0 is in the lowest 2 bits and encoder 1 is 4 bits higher.
+        for (uint32_t i = 0 ; i < 2 ; i++)
+        {
+            uint32_t shift = i * 4;
+            uint32_t previous = (m_pins >> shift) & 3;
+            uint32_t current = (pins >> shift) & 3;
+            if ((previous ^ current) == 3)
+            {
+                m_illegalTransitions[i]++;
+            }
+            else if (previous != current)
+            {
+                m_counts[i] += g_quadratureDeltas[(previous << 2) | current];
+                m_edgeCycles[i] = m_cycles;
+            }
+        }
+        m_pins = pins;
+    }
+}
+
+uint32_t RP2040DualEncoders::dmaEventWriteIndex()
+{
+    uint32_t writeAddr = dma_channel_hw_addr(m_dmaChannel)->write_addr;
+    return ((writeAddr - (uint32_t)(uintptr_t)m_eventRing) / sizeof(m_eventRing[0])) & (eventRingSize - 1);
+}
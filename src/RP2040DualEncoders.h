@@ -0,0 +1,140 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Class to use a single RP2040 PIO state machine to count the ticks of two quadrature encoders and time the edges.
+// It replaces the one state machine per encoder RP2040Encoders class and keeps what that class guaranteed: each edge is
+// timed by the state machine to within a pass (getLatestEdge()), the DMA channels re-arm themselves so that they never
+// stop however many events arrive, and the counts are read without locks. Only the one encoder per object API is gone.
+#pragma once
+
+#include <hardware/pio.h>
+#include <hardware/dma.h>
+#include <hardware/sync.h>
+
+
+class RP2040DualEncoders
+{
+    public:
+        // Constructor just sets up object. Need to call init() to actually start counting quadrature encoder ticks in
+        // the background.
+        RP2040DualEncoders();
+
+        // Call this init() method once to load the assembly language code into an available PIO (pio0 or pio1) and
+        // start counting the ticks of both encoders. A single state machine and 2 DMA channels are used for both
+        // of them.
+        // The state machine pushes the pin states each time they change and the DMA channels copy them into a ring
+        // buffer. A DMA interrupt, enabled on the core which calls init(), decodes each change from the ring buffer
+        // as soon as it has been copied and publishes the new counts. The ring buffer lets changes queue up while that
+        // interrupt is held off, but if it is held off for eventRingSize changes the oldest are overwritten, which
+        // getEventOverruns() reports. The getters below just read the published counts, without locking or decoding,
+        // so they can be called from either core or from other interrupt handlers.
+        //  pinBase - The lowest numbered GPIO pin connected to the first quadrature encoder. The other signal wire from
+        //            that encoder needs to be connected to pinBase+1 and the second encoder needs to be connected to
+        //            pinBase+4 and pinBase+5. The 2 pins in between are ignored.
+        // Returns true if everything was initialized successfully.
+        // Returns false if the assembly language code doesn't fit in either PIO or there aren't enough free state
+        // machines or DMA channels. Only one object can be initialized at a time.
+        bool init(uint32_t pinBase);
+
+        // Call this method to get the current count for one of the encoders. This is a single volatile load.
+        //  index - 0 for the encoder on pinBase and pinBase+1 or 1 for the encoder on pinBase+4 and pinBase+5.
+        //  Returns the accumulated counts so far for the specified quadrature encoder. The count goes up when the
+        //  signal on the lower numbered pin of the encoder leads the one on the higher numbered pin.
+        int32_t getCount(int32_t index);
+
+        // Call this method to get the current counts for both encoders at the same instant.
+        //  count0 - Set to the count for encoder 0.
+        //  count1 - Set to the count for encoder 1.
+        void getCounts(int32_t& count0, int32_t& count1);
+
+        // Call this method to get the current positions of both encoders at the same instant. These are the same as the
+        // counts except that they are accumulated in 64 bits so they never wrap around in practice.
+        //  position0 - Set to the position of encoder 0.
+        //  position1 - Set to the position of encoder 1.
+        void getPositions(int64_t& position0, int64_t& position1);
+
+        // The state machine runs at the system clock rate and samples the pins once per pass through its loop.
+        enum { CYCLES_PER_PASS = 8, EXTRA_CYCLES_PER_EVENT = 2 };
+
+        // Call this method to get the count and time of the latest edge seen on one of the encoders.
+        //  index - 0 or 1, the same as for getCount().
+        //  count - Set to the count after the latest edge, the same as would be returned by getCount().
+        //  cycles - Set to the time of the latest edge in PIO cycles. This can be compared with the cycles returned
+        //           for other edges of either encoder as long as there was never a gap of more than 2^26 passes
+        //           (over 4 seconds at 125MHz) without a pin change. It wraps around after 2^32 cycles.
+        void getLatestEdge(int32_t index, int32_t& count, uint32_t& cycles);
+
+        // Call this method to get the number of illegal transitions seen on one of the encoders. A transition is
+        // illegal if both of the encoder's signals changed at once, so the direction can't be told and the count
+        // isn't updated. These are caused by electrical glitches or by the encoder changing faster than the events can
+        // be handled, so each one probably means that counts have been missed.
+        //  index - 0 or 1, the same as for getCount().
+        //  Returns the number of illegal transitions seen since init() was called.
+        uint32_t getIllegalTransitions(int32_t index);
+
+        // Call this method to get the number of times that the ring buffer filled up before its events were decoded.
+        // The oldest events are overwritten when that happens so the counts of both encoders have probably missed
+        // some changes. The newest events still in the ring are decoded, and the jump from the pin states before the
+        // lost events to the ones after them can also show up as an illegal transition.
+        //  Returns the number of overruns seen since init() was called.
+        uint32_t getEventOverruns();
+
+    protected:
+        // Number of pin change events that the DMA ring buffer can hold. Must be a power of 2 to work with the DMA ring
+        // feature.
+        static const uint32_t eventRingSize = 256;
+        // The lower 26 bits of each event hold the pass counter.
+        static const uint32_t passMask = (1 << 26) - 1;
+        // Value that each event in the ring is replaced with once it has been decoded. The state machine only pushes
+        // it if the pins all change to low on the one pass in every 2^26 where the lower bits of its pass counter are
+        // 0, so a real event is very unlikely to be mistaken for it when checking for overruns.
+        static const uint32_t decodedEvent = 0;
+
+        static void dmaInterruptHandler();
+        // Decodes the events that the DMA channel has placed in the ring so far. Only called from the DMA interrupt.
+        void decodeEvents();
+        // Copies the decoder state that isn't a single word to the m_published* members for the getters.
+        void publish();
+        // Reads the positions and edge times published by the DMA interrupt, all from the same publish().
+        void readPublished(int64_t positions[2], uint32_t edgeCycles[2]);
+        uint32_t dmaEventWriteIndex();
+
+        PIO                 m_pio;
+        int32_t             m_stateMachine;
+        uint32_t            m_dmaChannel;
+        uint32_t            m_dmaControlChannel;
+        // The control channel writes this to the data channel's transfer count trigger register each time it finishes.
+        uint32_t            m_dmaTransferCount;
+
+        // Decoder state, only used by the DMA interrupt.
+        uint32_t            m_eventReadIndex;
+        bool                m_havePins;
+        uint32_t            m_pins;
+        uint32_t            m_passes;
+        uint32_t            m_cycles;
+        int64_t             m_counts[2];
+        uint32_t            m_edgeCycles[2];
+
+        // Published by the DMA interrupt for the getters. Single words are read directly. The rest are only
+        // consistent while m_generation is even and unchanged, since it is incremented before and after they are
+        // updated.
+        volatile uint32_t   m_generation;
+        volatile int32_t    m_publishedCounts[2];
+        volatile int64_t    m_publishedPositions[2];
+        volatile uint32_t   m_publishedEdgeCycles[2];
+        volatile uint32_t   m_illegalTransitions[2];
+        volatile uint32_t   m_eventOverruns;
+
+        alignas(eventRingSize * sizeof(uint32_t)) volatile uint32_t m_eventRing[eventRingSize];
+};
@@ -0,0 +1,49 @@
+// -------------------------------------------------- //
+// This file is autogenerated by pioasm; do not edit! //
+// -------------------------------------------------- //
+
+#pragma once
+
+#if !PICO_NO_HARDWARE
+#include "hardware/pio.h"
+#endif
+
+// ------------------ //
+// RP2040DualEncoders //
+// ------------------ //
+
+#define RP2040DualEncoders_wrap_target 0
+#define RP2040DualEncoders_wrap 10
+
+#define RP2040DualEncoders_offset_start 0u
+
+static const uint16_t RP2040DualEncoders_program_instructions[] = {
+            //     .wrap_target
+    0xa027, //  0: mov    x, osr                     
+    0x0042, //  1: jmp    x--, 2                     
+    0xa0e1, //  2: mov    osr, x                     
+    0xa0c3, //  3: mov    isr, null                  
+    0x4006, //  4: in     pins, 6                    
+    0xa026, //  5: mov    x, isr                     
+    0x00a8, //  6: jmp    x != y, 8                  
+    0x0000, //  7: jmp    0                          
+    0xa041, //  8: mov    y, x                       
+    0x40fa, //  9: in     osr, 26                    
+    0x8000, // 10: push   noblock                    
+            //     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program RP2040DualEncoders_program = {
+    .instructions = RP2040DualEncoders_program_instructions,
+    .length = 11,
+    .origin = -1,
+};
+
+static inline pio_sm_config RP2040DualEncoders_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + RP2040DualEncoders_wrap_target, offset + RP2040DualEncoders_wrap);
+    return c;
+}
+#endif
+
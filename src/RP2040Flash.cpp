@@ -0,0 +1,101 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Store a small record of data in a flash sector which has been set aside for it so that it survives a reset.
+#include <hardware/sync.h>
+#include "RP2040Flash.h"
+
+
+namespace Pololu3piPlus2040
+{
+    static_assert(POLOLU_3PI_PLUS_2040_FLASH_RECORD_OFFSET % FLASH_SECTOR_SIZE == 0,
+                  "POLOLU_3PI_PLUS_2040_FLASH_RECORD_OFFSET must be a multiple of FLASH_SECTOR_SIZE");
+
+    bool FlashRecord::read(uint32_t id, void* pData, size_t size)
+    {
+        if (size > maxSize)
+        {
+            return false;
+        }
+
+        // The flash is memory mapped so the record can be checked in place.
+        const uint8_t* pFlash = getFlashAddress();
+        Header header;
+        memcpy(&header, pFlash, sizeof(header));
+        if (header.id != id || header.size != size)
+        {
+            return false;
+        }
+
+        uint32_t expectedCrc;
+        memcpy(&expectedCrc, pFlash + sizeof(header) + size, sizeof(expectedCrc));
+        if (crc32(0, pFlash, sizeof(header) + size) != expectedCrc)
+        {
+            return false;
+        }
+
+        memcpy(pData, pFlash + sizeof(header), size);
+        return true;
+    }
+
+    bool FlashRecord::write(uint32_t id, const void* pData, size_t size)
+    {
+        if (size > maxSize)
+        {
+            return false;
+        }
+
+        // Lay out the whole page in RAM first since flash can only be programmed a page at a time.
+        uint8_t page[FLASH_PAGE_SIZE];
+        Header header = { id, (uint32_t)size };
+        memset(page, 0xFF, sizeof(page));
+        memcpy(page, &header, sizeof(header));
+        memcpy(page + sizeof(header), pData, size);
+        uint32_t crc = crc32(0, page, sizeof(header) + size);
+        memcpy(page + sizeof(header) + size, &crc, sizeof(crc));
+
+        // Code can't run from flash while it is being erased or programmed so keep interrupts from running until
+        // it is done. The SDK routines themselves run from RAM.
+        uint32_t interruptState = save_and_disable_interrupts();
+        flash_range_erase(POLOLU_3PI_PLUS_2040_FLASH_RECORD_OFFSET, FLASH_SECTOR_SIZE);
+        flash_range_program(POLOLU_3PI_PLUS_2040_FLASH_RECORD_OFFSET, page, sizeof(page));
+        restore_interrupts(interruptState);
+
+        return memcmp(getFlashAddress(), page, sizeof(page)) == 0;
+    }
+
+    void FlashRecord::erase()
+    {
+        uint32_t interruptState = save_and_disable_interrupts();
+        flash_range_erase(POLOLU_3PI_PLUS_2040_FLASH_RECORD_OFFSET, FLASH_SECTOR_SIZE);
+        restore_interrupts(interruptState);
+    }
+
+    uint32_t FlashRecord::crc32(uint32_t crc, const void* pData, size_t size)
+    {
+        // Bitwise CRC-32 (IEEE 802.3). The record is small and only checked at startup so a lookup table isn't
+        // worth the space.
+        const uint8_t* pCurr = (const uint8_t*)pData;
+        crc = ~crc;
+        while (size--)
+        {
+            crc ^= *pCurr++;
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+            }
+        }
+        return ~crc;
+    }
+} // namespace Pololu3piPlus2040
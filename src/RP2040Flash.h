@@ -0,0 +1,68 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Store a small record of data in a flash sector which has been set aside for it so that it survives a reset.
+#pragma once
+#include <Arduino.h>
+#include <hardware/flash.h>
+
+#ifndef ARDUINO_ARCH_RP2040
+#error "This library only supports the RP2040.  Try selecting Raspberry Pi Pico in the Boards menu."
+#endif
+
+// Offset from the start of flash of the sector used to store the record. It defaults to the last sector of the
+// flash size the board was built for, which is well past the end of any program. Define it before including this
+// header to move it elsewhere.
+#ifndef POLOLU_3PI_PLUS_2040_FLASH_RECORD_OFFSET
+#define POLOLU_3PI_PLUS_2040_FLASH_RECORD_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#endif
+
+
+namespace Pololu3piPlus2040
+{
+    class FlashRecord
+    {
+        public:
+            // The record, its header and CRC must all fit in one flash page.
+            static const size_t maxSize = FLASH_PAGE_SIZE - 3 * sizeof(uint32_t);
+
+            // Copies the record into pData. Returns false if the sector doesn't hold a record with a matching id and
+            // size or if its CRC doesn't match, in which case pData is left untouched.
+            //  id - Identifies the layout and version of the record. Change it whenever the layout changes so that
+            //       old records are ignored.
+            //  pData - Buffer to receive the record.
+            //  size - Size of the record in bytes. Must be no larger than maxSize.
+            static bool read(uint32_t id, void* pData, size_t size);
+
+            // Erases the sector and writes the record to it. Interrupts are disabled for the tens of milliseconds
+            // that this takes. Returns false if the record is too large or didn't read back correctly.
+            static bool write(uint32_t id, const void* pData, size_t size);
+
+            // Erases the sector so that read() fails until the next write().
+            static void erase();
+
+        protected:
+            struct Header
+            {
+                uint32_t id;
+                uint32_t size;
+            };
+
+            static const uint8_t* getFlashAddress()
+            {
+                return (const uint8_t*)(XIP_BASE + POLOLU_3PI_PLUS_2040_FLASH_RECORD_OFFSET);
+            }
+            static uint32_t crc32(uint32_t crc, const void* pData, size_t size);
+    };
+} // namespace Pololu3piPlus2040
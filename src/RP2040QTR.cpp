@@ -14,6 +14,8 @@
 */
 // Use the RP2040's PIO state machines to read the 7 QTR light sensors on the
 // 3π+ 2040 robot. It is a C/C++ port of Pololu's MicroPython code.
+#include <hardware/irq.h>
+#include <hardware/timer.h>
 #include "RP2040QTR.h"
 
 
@@ -21,9 +23,195 @@ namespace Pololu3piPlus2040
 {
     static QTRSensors g_singletonQTR;
 
+    // The object running in continuous mode. Used by the PIO interrupt handler.
+    static QTRSensors* g_pContinuousQTR = NULL;
+
     QTRSensors* QTRSensors::getSharedQTR()
     {
         return &g_singletonQTR;
     }
 
+    bool QTRSensors::setEarlyExit(bool enable)
+    {
+        if (enable == m_earlyExit)
+        {
+            return true;
+        }
+        if (m_stateMachine < 0 ||
+            !isTickFrequencySupported(m_tickFrequency, enable ? earlyExitLoopCycles : standardLoopCycles))
+        {
+            return false;
+        }
+
+        // Stop the state machine before swapping out the code that it is running.
+        bool wasContinuous = stopForReconfiguration();
+
+        // Only one of the programs is loaded at a time to leave as much PIO program memory free as possible for other
+        // code. Removing the old one first also makes room for the new one to be loaded in the same spot.
+        pio_remove_program(m_pio, getProgram(m_earlyExit), m_codeOffset);
+        bool result = pio_can_add_program(m_pio, getProgram(enable));
+        if (result)
+        {
+            m_earlyExit = enable;
+        }
+        m_codeOffset = pio_add_program(m_pio, getProgram(m_earlyExit));
+
+        // The programs take a different number of cycles per tick so the clock divider and charge count need to be
+        // recalculated too.
+        initStateMachine();
+        if (wasContinuous)
+        {
+            startContinuous(m_pinMask);
+        }
+
+        return result;
+    }
+
+    bool QTRSensors::stopForReconfiguration()
+    {
+        bool wasContinuous = isContinuous();
+        if (wasContinuous)
+        {
+            stopContinuous();
+        }
+        else if (isReadPending())
+        {
+            finishRead();
+        }
+        pio_sm_set_enabled(m_pio, m_stateMachine, false);
+        m_stateMachineWaiting = false;
+
+        return wasContinuous;
+    }
+
+    void QTRSensors::applySettings()
+    {
+        if (m_stateMachine < 0)
+        {
+            return;
+        }
+
+        bool wasContinuous = stopForReconfiguration();
+        initStateMachine();
+        if (wasContinuous)
+        {
+            startContinuous(m_pinMask);
+        }
+    }
+
+    bool QTRSensors::startContinuous(uint8_t pinMask)
+    {
+        if (m_state == CONTINUOUS)
+        {
+            return true;
+        }
+        if (m_stateMachine < 0 || m_dmaChannel < 0)
+        {
+            return false;
+        }
+
+        // Wait for any single read in progress to complete.
+        if (m_state == READING)
+        {
+            finishRead();
+        }
+        m_pinMask = pinMask & ALL_SENSORS_MASK;
+        restartStateMachine();
+        m_frameSequence = 0;
+
+        // The state machine raises its IRQ flag at the end of each frame. Route it to the CPU so that the frame can
+        // be decoded and the state machine allowed to start the next one.
+        uint irqNumber = (m_pio == pio0) ? PIO0_IRQ_0 : PIO1_IRQ_0;
+        g_pContinuousQTR = this;
+        irq_add_shared_handler(irqNumber, frameInterruptHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        pio_set_irq0_source_enabled(m_pio, (enum pio_interrupt_source)(pis_interrupt0 + m_stateMachine), true);
+        irq_set_enabled(irqNumber, true);
+
+        m_state = CONTINUOUS;
+        pio_sm_set_enabled(m_pio, m_stateMachine, true);
+
+        return true;
+    }
+
+    void QTRSensors::stopContinuous()
+    {
+        if (m_state != CONTINUOUS)
+        {
+            return;
+        }
+
+        uint irqNumber = (m_pio == pio0) ? PIO0_IRQ_0 : PIO1_IRQ_0;
+        pio_sm_set_enabled(m_pio, m_stateMachine, false);
+        pio_set_irq0_source_enabled(m_pio, (enum pio_interrupt_source)(pis_interrupt0 + m_stateMachine), false);
+        irq_remove_handler(irqNumber, frameInterruptHandler);
+        g_pContinuousQTR = NULL;
+        pio_sm_clear_fifos(m_pio, m_stateMachine);
+        m_continuousReadPending = false;
+        m_state = IDLE;
+    }
+
+    bool QTRSensors::getLatestFrame(QTRSensorFrame& frame)
+    {
+        while (true)
+        {
+            uint32_t sequence = m_frameSequence;
+            if (sequence == 0)
+            {
+                return false;
+            }
+
+            frame = m_frameRing[sequence % frameRingSize];
+
+            // The interrupt handler writes to a different slot in the ring than the latest one so the copy is
+            // only torn if it managed to wrap all the way around the ring while we were copying.
+            __dmb();
+            if (m_frameSequence - sequence < frameRingSize - 1)
+            {
+                return true;
+            }
+        }
+    }
+
+    void QTRSensors::frameInterruptHandler()
+    {
+        if (g_pContinuousQTR)
+        {
+            g_pContinuousQTR->handleFrameInterrupt();
+        }
+    }
+
+    void QTRSensors::handleFrameInterrupt()
+    {
+        // This handler is shared with anything else using this PIO's IRQ0 so make sure that it was our state machine
+        // which signalled the end of a frame.
+        if (!pio_interrupt_get(m_pio, m_stateMachine))
+        {
+            return;
+        }
+        uint64_t timestamp = time_us_64();
+
+        // Decode the FIFO events for this frame that the DMA channel has placed in the ring. The state machine
+        // pushed the terminator before raising the IRQ flag but the DMA transfer could still be in flight so keep
+        // checking the DMA write pointer until the terminator shows up.
+        uint32_t sequence = m_frameSequence + 1;
+        QTRSensorFrame& frame = m_frameRing[sequence % frameRingSize];
+        uint32_t pendingPins;
+        initReadings(frame.readings, pendingPins);
+        while (!decodeEvents(frame.readings, pendingPins))
+        {
+        }
+        frame.sequence = sequence;
+        frame.timestamp = timestamp;
+        __dmb();
+        m_frameSequence = sequence;
+
+        // The state machine is stalled until its IRQ flag is cleared so no DMA transfers are pending. This makes it a
+        // safe time to reset the DMA transfer count before it runs out.
+        refreshDmaTransferCount();
+
+        // Queue up the configuration word for the next frame and then let the state machine start it.
+        pio_sm_put(m_pio, m_stateMachine, m_readConfig);
+        pio_interrupt_clear(m_pio, m_stateMachine);
+    }
+
 } // namespace Pololu3piPlus2040
@@ -17,6 +17,7 @@
 #pragma once
 #include <Arduino.h>
 #include <hardware/clocks.h>
+#include <hardware/dma.h>
 #include "RP2040SIO.h"
 #include "RP2040QTR.pio.h"
 
@@ -63,6 +64,16 @@ namespace Pololu3piPlus2040
         };
     };
 
+    // A set of readings captured by the continuous acquisition mode.
+    struct QTRSensorFrame
+    {
+        QTRSensorReadings readings;
+        // Incremented for each frame captured since continuous mode was started. The first frame is 1.
+        uint32_t          sequence;
+        // The time_us_64() value at which the discharge for this frame completed.
+        uint64_t          timestamp;
+    };
+
     class QTRSensors
     {
         protected:
@@ -70,31 +81,90 @@ namespace Pololu3piPlus2040
             static const uint32_t lightSensorPinBase = 16;
             static const uint32_t lightSensorPinCount = LIGHT_SENSOR_COUNT;
 
+            // Number of FIFO events that the DMA ring buffer can hold. A read never generates more than 8 events
+            // (7 pin changes + the terminator) so this leaves room for the interrupt handler to fall a few frames
+            // behind in continuous mode. Must be a power of 2 to work with the DMA ring feature.
+            static const uint32_t eventRingSize = 32;
+            // Number of decoded frames kept in the frame ring buffer.
+            static const uint32_t frameRingSize = 4;
+
+            // Number of PIO cycles taken by each pass through the counting loop of the two PIO programs.
+            static const uint32_t standardLoopCycles = 8;
+            static const uint32_t earlyExitLoopCycles = 9;
+
+            // The PIO programs receive the charge time and timeout as 16-bit counts.
+            static const uint32_t maxCount = 0xFFFF;
+
             PIO      m_pio = pio0;
             int32_t  m_stateMachine = -1;
             uint32_t m_codeOffset = 0;
-            enum {
+            bool     m_earlyExit = false;
+            volatile enum {
                 IDLE,
                 READING,
+                CONTINUOUS,
             }  m_state = IDLE;
 
+            // Read timing settings and the configuration word that they are converted into for the PIO programs.
+            uint32_t m_timeout = TIMEOUT;
+            uint32_t m_chargeTime = CHARGE_TIME;
+            uint32_t m_tickFrequency = TICK_FREQUENCY;
+            uint16_t m_maxReading = TIMEOUT;
+            uint32_t m_readConfig = 0;
+            // Mask of the sensors being read by the single read or continuous mode in progress.
+            uint8_t  m_pinMask = ALL_SENSORS_MASK;
+
+            // The DMA channel streams the raw FIFO events into m_eventRing for both single reads and continuous mode.
+            int32_t           m_dmaChannel = -1;
+            uint32_t          m_eventReadIndex = 0;
+            alignas(eventRingSize * sizeof(uint32_t)) volatile uint32_t m_eventRing[eventRingSize];
+
+            // Single read state. isReadComplete() decodes the events into m_readings as they arrive.
+            QTRSensorReadings m_readings;
+            uint32_t          m_pendingPins = 0;
+            bool              m_readComplete = false;
+            // Is the state machine sitting at the end of a completed single read, waiting for its IRQ flag to be
+            // cleared? The next read can then be started without restarting the state machine.
+            bool              m_stateMachineWaiting = false;
+            // Results of another caller's read which were collected by takePendingRead() so that a blocking read
+            // could run in between. They are handed back by the next finishRead().
+            QTRSensorReadings m_heldReadings;
+            bool              m_readingsHeld = false;
+
+            // Continuous mode state. The PIO interrupt handler decodes the events into m_frameRing.
+            volatile uint32_t m_frameSequence = 0;
+            uint32_t          m_readStartSequence = 0;
+            bool              m_continuousReadPending = false;
+            QTRSensorFrame    m_frameRing[frameRingSize];
+
         public:
+            // Default read timeout in microseconds. With the default tick frequency of 1MHz, this is also the reading
+            // returned for sensors which haven't discharged before the timeout.
             static const uint32_t TIMEOUT = 1024;
+            // Default time to charge the sensor capacitors for before each read, in microseconds.
+            static const uint32_t CHARGE_TIME = 32;
+            // Default frequency at which the discharge time is measured, in Hz. Each reading is a count of these ticks.
+            static const uint32_t TICK_FREQUENCY = 1000000;
+
+            // Masks for selecting a subset of the sensors to read. Bit i corresponds to QTRSensorReadings::raw[i].
+            static const uint8_t ALL_SENSORS_MASK = (1 << LIGHT_SENSOR_COUNT) - 1;
+            static const uint8_t BUMP_SENSORS_MASK = (1 << BUMP_SENSOR_COUNT) - 1;
+            static const uint8_t LINE_SENSORS_MASK = ALL_SENSORS_MASK & ~BUMP_SENSORS_MASK;
 
             QTRSensors()
             {
                 // Make sure that there is enough room to load this program into one of the PIO instances.
                 m_pio = pio0;
-                if (!pio_can_add_program(m_pio, &RP2040QTR_program) )
+                if (!pio_can_add_program(m_pio, getProgram(m_earlyExit)) )
                 {
                     m_pio = pio1;
-                    if (!pio_can_add_program(m_pio, &RP2040QTR_program) )
+                    if (!pio_can_add_program(m_pio, getProgram(m_earlyExit)) )
                     {
                         assert ( !"No free PIO" );
                         return;
                     }
                 }
-                m_codeOffset = pio_add_program(m_pio, &RP2040QTR_program);
+                m_codeOffset = pio_add_program(m_pio, getProgram(m_earlyExit));
 
                 // Find an unused state machine in the PIO to run the code for counting this encoder.
                 m_stateMachine = pio_claim_unused_sm(m_pio, false);
@@ -105,6 +175,15 @@ namespace Pololu3piPlus2040
                     return;
                 }
 
+                // Find an unused DMA channel to copy the events out of the state machine's RX FIFO.
+                m_dmaChannel = dma_claim_unused_channel(false);
+                if (m_dmaChannel < 0)
+                {
+                    // No free DMA channels so return a failure code.
+                    assert ( !"No free DMA channels" );
+                    return;
+                }
+
                 // Connect the 7 sensor pins to the PIO peripheral for output.
                 for (uint32_t pin = lightSensorPinBase ; pin < lightSensorPinBase + lightSensorPinCount ; pin++)
                 {
@@ -117,85 +196,397 @@ namespace Pololu3piPlus2040
                 uint32_t pinMask = ((1 << lightSensorPinCount) - 1) << lightSensorPinBase;
                 pio_sm_set_pins_with_mask(m_pio, m_stateMachine, pinMask, pinMask);
 
+                initStateMachine();
+                initDma();
+            }
+
+            // Selects which PIO program is used for reading the sensors. By default the standard program is used and
+            // it always counts down the full timeout before completing a read. With early exit enabled, the read
+            // completes as soon as all of the sensors have discharged instead which is much quicker over bright
+            // surfaces. The readings themselves are the same either way.
+            // Returns false if there isn't enough free PIO program memory to load the requested program or the PIO
+            // can't be clocked fast enough for it to run at the current tick frequency. The previous program is left
+            // in place in that case.
+            bool setEarlyExit(bool enable);
+
+            bool isEarlyExitEnabled()
+            {
+                return m_earlyExit;
+            }
+
+            // Sets how long to wait for the sensors to discharge, in microseconds. Sensors which haven't discharged
+            // by then return getMaxReading(). Shorter timeouts make for quicker reads on high contrast surfaces.
+            // Any read in progress is completed first and continuous mode is restarted with the new setting.
+            void setTimeout(uint32_t timeoutMicroseconds)
+            {
+                m_timeout = timeoutMicroseconds;
+                applySettings();
+            }
+
+            uint32_t getTimeout()
+            {
+                return m_timeout;
+            }
+
+            // Sets how long to charge the sensor capacitors for before timing their discharge, in microseconds.
+            void setChargeTime(uint32_t chargeMicroseconds)
+            {
+                m_chargeTime = chargeMicroseconds;
+                applySettings();
+            }
+
+            uint32_t getChargeTime()
+            {
+                return m_chargeTime;
+            }
+
+            // Sets the frequency, in Hz, at which the discharge time is measured. The readings are counts of these
+            // ticks so a higher frequency gives finer resolution. The timeout stays the same length in microseconds
+            // but getMaxReading() scales with the frequency, up to a maximum of 65535 ticks.
+            // Returns false if the PIO can't be clocked at a rate that supports this frequency. The previous
+            // frequency is left in place in that case.
+            bool setTickFrequency(uint32_t frequencyHz)
+            {
+                if (!isTickFrequencySupported(frequencyHz, getLoopCycles()))
+                {
+                    return false;
+                }
+                m_tickFrequency = frequencyHz;
+                applySettings();
+                return true;
+            }
+
+            uint32_t getTickFrequency()
+            {
+                return m_tickFrequency;
+            }
+
+            // The reading returned for a sensor which didn't discharge before the timeout. It is the timeout
+            // measured in ticks of the tick frequency so all readings are in the range 1 to getMaxReading().
+            uint16_t getMaxReading()
+            {
+                return m_maxReading;
+            }
+
+            // Starts a read of the sensors in 'pinMask' in the background. Use isReadComplete() to poll for its
+            // completion and finishRead() to fetch the results. The sensors outside of the mask aren't charged or
+            // timed and read as 0. With early exit enabled, the read completes as soon as the sensors in the mask
+            // have discharged. The mask is ignored in continuous mode, where the one given to startContinuous() is
+            // used instead. When the previous read used the same mask, this one is started without restarting the
+            // state machine so that consecutive reads, such as the emitters on and off captures of an ambient light
+            // cancelling read, run back to back.
+            // Returns false if a read is already in progress.
+            bool startRead(uint8_t pinMask = ALL_SENSORS_MASK)
+            {
+                if (isReadPending())
+                {
+                    return false;
+                }
+                if (m_state == CONTINUOUS)
+                {
+                    // The state machine is already free-running so just remember which frame was last completed.
+                    m_readStartSequence = m_frameSequence;
+                    m_continuousReadPending = true;
+                    return true;
+                }
+
+                pinMask &= ALL_SENSORS_MASK;
+                if (m_stateMachineWaiting && pinMask == m_pinMask)
+                {
+                    // The state machine is still configured for this read so let it start right away, back to back
+                    // with the previous one. It raises its IRQ flag a cycle after pushing the terminator so make sure
+                    // that it has actually reached that point before clearing it.
+                    while (!pio_interrupt_get(m_pio, m_stateMachine))
+                    {
+                    }
+                    refreshDmaTransferCount();
+                    initReadings(m_readings, m_pendingPins);
+                    m_readComplete = false;
+                    m_stateMachineWaiting = false;
+                    m_state = READING;
+                    pio_sm_put(m_pio, m_stateMachine, m_readConfig);
+                    pio_interrupt_clear(m_pio, m_stateMachine);
+                    return true;
+                }
+
+                // Restart the state machine to see how long the capacitor takes to discharge through the QTR.
+                m_pinMask = pinMask;
+                restartStateMachine();
+                initReadings(m_readings, m_pendingPins);
+                m_readComplete = false;
+                m_state = READING;
+                // Start the state machine up again.
+                pio_sm_set_enabled(m_pio, m_stateMachine, true);
+                return true;
+            }
+
+            // Has a read been started with startRead() that hasn't been finished with finishRead() yet?
+            bool isReadPending()
+            {
+                return m_state == READING || m_continuousReadPending || m_readingsHeld;
+            }
+
+            // Returns true once the read started by startRead() has completed. Never blocks. It decodes any events
+            // which have arrived so far so it can be called as often as desired.
+            bool isReadComplete()
+            {
+                if (m_readingsHeld)
+                {
+                    return true;
+                }
+                if (m_state == CONTINUOUS)
+                {
+                    // The frame in progress when startRead() was called could have started before the caller
+                    // configured the emitters. Wait for the frame after it to complete.
+                    return !m_continuousReadPending || m_frameSequence - m_readStartSequence >= 2;
+                }
+                if (m_state != READING)
+                {
+                    return true;
+                }
+
+                if (!m_readComplete)
+                {
+                    m_readComplete = decodeEvents(m_readings, m_pendingPins);
+                    m_stateMachineWaiting = m_readComplete;
+                }
+                return m_readComplete;
+            }
+
+            // Waits for the read started by startRead() to complete and returns its results.
+            QTRSensorReadings finishRead()
+            {
+                while (!isReadComplete())
+                {
+                }
+                if (m_readingsHeld)
+                {
+                    m_readingsHeld = false;
+                    return m_heldReadings;
+                }
+                if (m_state == CONTINUOUS)
+                {
+                    QTRSensorFrame frame;
+                    getLatestFrame(frame);
+                    m_continuousReadPending = false;
+                    return frame.readings;
+                }
+                m_state = IDLE;
+
+                return m_readings;
+            }
+
+            QTRSensorReadings read(uint8_t pinMask = ALL_SENSORS_MASK)
+            {
+                startRead(pinMask);
+                return finishRead();
+            }
+
+            // The state machine is shared by the line and bump sensor classes, so a blocking read can find that
+            // another one has a split phase read pending. This waits for that read to complete and copies its results
+            // into 'readings', leaving the state machine free for the blocking read. Pass them to holdReadings()
+            // once that is done so that the other caller still gets them from its next finishRead().
+            // Returns false, without touching 'readings', if no read was pending.
+            bool takePendingRead(QTRSensorReadings& readings)
+            {
+                if (!isReadPending())
+                {
+                    return false;
+                }
+                readings = finishRead();
+                return true;
+            }
+
+            // Makes 'readings' the results of a completed read that is still pending. The next finishRead() returns
+            // them.
+            void holdReadings(const QTRSensorReadings& readings)
+            {
+                m_heldReadings = readings;
+                m_readingsHeld = true;
+            }
+
+            // Starts the free-running acquisition mode. The state machine runs back to back reads, the DMA channel
+            // streams its FIFO events into RAM, and an interrupt handler decodes them into a ring of frames. Use
+            // getLatestFrame() to fetch the most recent one without waiting. Only the sensors in 'pinMask' are read
+            // as described for startRead().
+            // Returns false if the state machine couldn't be initialized.
+            bool startContinuous(uint8_t pinMask = ALL_SENSORS_MASK);
+
+            // Stops the free-running acquisition mode started by startContinuous().
+            void stopContinuous();
+
+            // Is the free-running acquisition mode currently running?
+            bool isContinuous()
+            {
+                return m_state == CONTINUOUS;
+            }
+
+            // Copies the most recently decoded frame into 'frame'.
+            // Returns false if no frame has been captured yet since continuous mode was started.
+            bool getLatestFrame(QTRSensorFrame& frame);
+
+            static QTRSensors* getSharedQTR();
+
+        protected:
+            static const pio_program_t* getProgram(bool earlyExit)
+            {
+                return earlyExit ? &RP2040QTREarlyExit_program : &RP2040QTR_program;
+            }
+
+            uint32_t getLoopCycles()
+            {
+                return m_earlyExit ? earlyExitLoopCycles : standardLoopCycles;
+            }
+
+            static bool isTickFrequencySupported(uint32_t frequencyHz, uint32_t loopCycles)
+            {
+                // The PIO clock divider has a 16-bit integer part and can't run faster than the system clock.
+                if (frequencyHz == 0)
+                {
+                    return false;
+                }
+                float div = (float)clock_get_hz(clk_sys) / ((float)loopCycles * frequencyHz);
+                return div >= 1.0f && div < 65536.0f;
+            }
+
+            void initStateMachine()
+            {
                 // Configure the state machine to run the QTR sampling program.
-                pio_sm_config smConfig = RP2040QTR_program_get_default_config(m_codeOffset);
+                pio_sm_config smConfig = m_earlyExit ? RP2040QTREarlyExit_program_get_default_config(m_codeOffset) :
+                                                       RP2040QTR_program_get_default_config(m_codeOffset);
                 const bool shiftLeft = false;
                 const bool autoPush = true;
                 const uint pushThreshold = 23;
                 sm_config_set_in_shift(&smConfig, shiftLeft, autoPush, pushThreshold);
                 sm_config_set_in_pins(&smConfig, lightSensorPinBase);
                 sm_config_set_out_pins(&smConfig, lightSensorPinBase, lightSensorPinCount);
-                // Use the TX FIFO entries for RX since we don't use the TX path. This makes for an 8 element RX FIFO.
-                sm_config_set_fifo_join(&smConfig, PIO_FIFO_JOIN_RX);
-                // Configure the state machine to run at 8MHz.
-                float div = (float)clock_get_hz(clk_sys) / 8000000.0f;
+                // Clock the state machine so that each pass through the counting loop takes 1 tick.
+                float div = (float)clock_get_hz(clk_sys) / ((float)getLoopCycles() * m_tickFrequency);
                 sm_config_set_clkdiv(&smConfig, div);
                 pio_sm_init(m_pio, m_stateMachine, m_codeOffset, &smConfig);
+                m_stateMachineWaiting = false;
+
+                // Convert the timing settings into the configuration word that the PIO program pulls from the TX FIFO
+                // at the start of each read.
+                uint32_t timeoutTicks = (uint32_t)(((uint64_t)m_timeout * m_tickFrequency + 500000) / 1000000);
+                uint32_t chargeCycles = (uint32_t)(((uint64_t)m_chargeTime * m_tickFrequency * getLoopCycles() + 500000)
+                                                   / 1000000);
+                timeoutTicks = constrain(timeoutTicks, 1, maxCount);
+                chargeCycles = constrain(chargeCycles, 1, maxCount);
+                m_maxReading = timeoutTicks;
+                m_readConfig = ((timeoutTicks - 1) << 16) | (chargeCycles - 1);
             }
 
-            void startRead()
+            void initDma()
             {
-                if (m_state == READING)
+                // Configure DMA to copy each FIFO event from the state machine into the event ring buffer. The write
+                // address wraps around within the ring so the transfer count is the only thing that will ever run out.
+                dma_channel_config dmaConfig = dma_channel_get_default_config(m_dmaChannel);
+                channel_config_set_read_increment(&dmaConfig, false);
+                channel_config_set_write_increment(&dmaConfig, true);
+                channel_config_set_ring(&dmaConfig, true, __builtin_ctz(sizeof(m_eventRing)));
+                channel_config_set_dreq(&dmaConfig, pio_get_dreq(m_pio, m_stateMachine, false));
+                dma_channel_configure(m_dmaChannel, &dmaConfig,
+                    m_eventRing,                    // Destination pointer
+                    &m_pio->rxf[m_stateMachine],    // Source pointer
+                    0xFFFFFFFF,                     // Largest possible number of transfers
+                    true                            // Start immediately
+                );
+                m_eventReadIndex = 0;
+            }
+
+            void refreshDmaTransferCount()
+            {
+                // Only call this when the state machine is stalled or stopped so that no DMA transfers are pending.
+                // Stopping the DMA channel and starting it again will reload the original 0xFFFFFFFF transfer count
+                // while leaving the write pointer where it is in the ring.
+                if (dma_channel_hw_addr(m_dmaChannel)->transfer_count < 0x80000000)
                 {
-                    return;
+                    dma_channel_abort(m_dmaChannel);
+                    dma_channel_start(m_dmaChannel);
                 }
+            }
 
-                // Restart the state machine to see how long the capacitor takes to discharge through the QTR.
+            void restartStateMachine()
+            {
                 pio_sm_set_enabled(m_pio, m_stateMachine, false);
-                // Initialize the registers in the state machine so that I don't need to waste precious PIO code space.
-                // Set OSR to 32 bits of 1s for future shifting out to initialize y, x, pindirs, and y again. This
-                // requires 7 + 8 + 10 + 7 = 32 bits.
-                pio_sm_exec(m_pio, m_stateMachine, pio_encode_mov_not(pio_osr, pio_null));
-                // Set Y counter to 255 by pulling 8 high bits from OSR. At 8MHz this results in ~32us of charge time.
-                pio_sm_exec(m_pio, m_stateMachine, pio_encode_out(pio_y, 8));
-                // Initialize X (last pin state) to 7 bits of 1s.
-                pio_sm_exec(m_pio, m_stateMachine, pio_encode_out(pio_x, 7));
-                // Reset the program counter back to the beginning of the program.
+                m_stateMachineWaiting = false;
+                // The previous read left the state machine waiting for its IRQ flag to be cleared so reset that
+                // wait state and the flag itself.
+                pio_sm_restart(m_pio, m_stateMachine);
+                pio_sm_clear_fifos(m_pio, m_stateMachine);
+                pio_interrupt_clear(m_pio, m_stateMachine);
+                // Drive the pins to be read high and the rest low for when the PIO code enables their outputs. The
+                // PIO code reads this back as its mask of active pins.
+                uint32_t pinMask = ((1 << lightSensorPinCount) - 1) << lightSensorPinBase;
+                pio_sm_set_pins_with_mask(m_pio, m_stateMachine, (uint32_t)m_pinMask << lightSensorPinBase, pinMask);
+                // Skip any events left in the ring by a read which was interrupted part way through.
+                m_eventReadIndex = dmaEventWriteIndex();
+                refreshDmaTransferCount();
+                // Reset the program counter back to the beginning of the program and queue up the configuration
+                // word that it will pull in for the first read.
                 pio_sm_exec(m_pio, m_stateMachine, pio_encode_jmp(m_codeOffset));
-                // Start the state machine up again.
-                pio_sm_set_enabled(m_pio, m_stateMachine, true);
-                m_state = READING;
+                pio_sm_put(m_pio, m_stateMachine, m_readConfig);
             }
 
-            QTRSensorReadings read()
-            {
-                startRead();
-
-                QTRSensorReadings readings;
+            bool stopForReconfiguration();
+            void applySettings();
 
+            void initReadings(QTRSensorReadings& readings, uint32_t& pendingPins)
+            {
                 for (size_t i = 0 ; i < sizeof(readings.raw)/sizeof(readings.raw[0]) ; i++)
                 {
-                    readings.raw[i] = TIMEOUT;
+                    readings.raw[i] = (m_pinMask & (1 << i)) ? m_maxReading : 0;
+                }
+                pendingPins = m_pinMask;
+            }
+
+            // 'pendingPins' tracks the sensors which haven't discharged yet. Each event only needs to visit the
+            // pending sensors which are now low so each reading is written exactly once. Any later events caused by
+            // a sensor bouncing back high are ignored since the sensor is no longer pending.
+            void decodeEvent(uint32_t val, QTRSensorReadings& readings, uint32_t& pendingPins)
+            {
+                uint32_t discharged = pendingPins & ~(val >> 16);
+                if (discharged == 0)
+                {
+                    return;
                 }
-                uint32_t lastPinStates = (1 << lightSensorPinCount) - 1;
+                uint16_t reading = m_maxReading - (val & 0xFFFF);
+                pendingPins &= ~discharged;
+                do
+                {
+                    uint32_t i = __builtin_ctz(discharged);
+                    readings.raw[i] = reading;
+                    discharged &= discharged - 1;
+                } while (discharged);
+            }
 
-                while (true)
+            // Decodes the events that the DMA channel has placed in the ring so far.
+            // Returns true once the terminator for the current read has been reached.
+            bool decodeEvents(QTRSensorReadings& readings, uint32_t& pendingPins)
+            {
+                while (m_eventReadIndex != dmaEventWriteIndex())
                 {
-                    uint32_t val = pio_sm_get_blocking(m_pio, m_stateMachine);
+                    uint32_t val = m_eventRing[m_eventReadIndex];
+                    m_eventReadIndex = (m_eventReadIndex + 1) & (eventRingSize - 1);
                     if (val == 0xFFFFFFFF)
                     {
                         // The PIO code returns -1 when it stops.
-                        break;
-                    }
-                    uint32_t currPinStates = (val >> 16) & 0x7F;
-                    uint32_t currTime = val & 0xFFFF;
-                    uint32_t newZeros = lastPinStates ^ currPinStates;
-                    for (size_t i = 0 ; i < sizeof(readings.raw)/sizeof(readings.raw[0]) ; i++)
-                    {
-                        uint32_t bitmask = 1 << i;
-                        if ((newZeros & bitmask) && readings.raw[i] == TIMEOUT)
-                        {
-                            readings.raw[i] = TIMEOUT - currTime;
-                        }
+                        return true;
                     }
-                    lastPinStates = currPinStates;
+                    decodeEvent(val, readings, pendingPins);
                 }
-                m_state = IDLE;
+                return false;
+            }
 
-                return readings;
+            uint32_t dmaEventWriteIndex()
+            {
+                uint32_t writeAddr = dma_channel_hw_addr(m_dmaChannel)->write_addr;
+                return ((writeAddr - (uint32_t)(uintptr_t)m_eventRing) / sizeof(m_eventRing[0])) & (eventRingSize - 1);
             }
 
-            static QTRSensors* getSharedQTR();
+            void handleFrameInterrupt();
+            static void frameInterruptHandler();
     };
 
 } // namespace Pololu3piPlus2040
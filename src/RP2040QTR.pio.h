@@ -12,35 +12,41 @@
 // RP2040QTR //
 // --------- //
 
-#define RP2040QTR_wrap_target 16
-#define RP2040QTR_wrap 16
+#define RP2040QTR_wrap_target 0
+#define RP2040QTR_wrap 22
 
 static const uint16_t RP2040QTR_program_instructions[] = {
-    0x6087, //  0: out    pindirs, 7                 
-    0x0081, //  1: jmp    y--, 1                     
-    0x604a, //  2: out    y, 10                      
-    0xa0e3, //  3: mov    osr, null                  
-    0x6087, //  4: out    pindirs, 7                 
-    0x4007, //  5: in     pins, 7                    
-    0xa0e2, //  6: mov    osr, y                     
-    0xa046, //  7: mov    y, isr                     
-    0x00ab, //  8: jmp    x != y, 11                 
-    0xa0c3, //  9: mov    isr, null                  
-    0x000d, // 10: jmp    13                         
-    0xa022, // 11: mov    x, y                       
-    0x40f0, // 12: in     osr, 16                    
-    0xa047, // 13: mov    y, osr                     
-    0x0085, // 14: jmp    y--, 5                     
-    0x4040, // 15: in     y, 32                      
             //     .wrap_target
-    0xa042, // 16: nop                               
+    0xa0eb, //  0: mov    osr, !null                 
+    0x6087, //  1: out    pindirs, 7                 
+    0x80a0, //  2: pull   block                      
+    0x6050, //  3: out    y, 16                      
+    0x0084, //  4: jmp    y--, 4                     
+    0x6050, //  5: out    y, 16                      
+    0x4007, //  6: in     pins, 7                    
+    0xa026, //  7: mov    x, isr                     
+    0xa0c3, //  8: mov    isr, null                  
+    0xa0e9, //  9: mov    osr, !x                    
+    0x6087, // 10: out    pindirs, 7                 
+    0x4007, // 11: in     pins, 7                    
+    0xa0e2, // 12: mov    osr, y                     
+    0xa046, // 13: mov    y, isr                     
+    0x00b1, // 14: jmp    x != y, 17                 
+    0xa0c3, // 15: mov    isr, null                  
+    0x0013, // 16: jmp    19                         
+    0xa022, // 17: mov    x, y                       
+    0x40f0, // 18: in     osr, 16                    
+    0xa047, // 19: mov    y, osr                     
+    0x008b, // 20: jmp    y--, 11                    
+    0x4040, // 21: in     y, 32                      
+    0xc030, // 22: irq    wait 0 rel                 
             //     .wrap
 };
 
 #if !PICO_NO_HARDWARE
 static const struct pio_program RP2040QTR_program = {
     .instructions = RP2040QTR_program_instructions,
-    .length = 17,
+    .length = 23,
     .origin = -1,
 };
 
@@ -51,3 +57,54 @@ static inline pio_sm_config RP2040QTR_program_get_default_config(uint offset) {
 }
 #endif
 
+// ------------------ //
+// RP2040QTREarlyExit //
+// ------------------ //
+
+#define RP2040QTREarlyExit_wrap_target 0
+#define RP2040QTREarlyExit_wrap 24
+
+static const uint16_t RP2040QTREarlyExit_program_instructions[] = {
+            //     .wrap_target
+    0xa0eb, //  0: mov    osr, !null                 
+    0x6087, //  1: out    pindirs, 7                 
+    0x80a0, //  2: pull   block                      
+    0x6050, //  3: out    y, 16                      
+    0x0084, //  4: jmp    y--, 4                     
+    0x6050, //  5: out    y, 16                      
+    0x4007, //  6: in     pins, 7                    
+    0xa026, //  7: mov    x, isr                     
+    0xa0c3, //  8: mov    isr, null                  
+    0xa0e9, //  9: mov    osr, !x                    
+    0x6087, // 10: out    pindirs, 7                 
+    0x4007, // 11: in     pins, 7                    
+    0xa0e2, // 12: mov    osr, y                     
+    0xa046, // 13: mov    y, isr                     
+    0x00b1, // 14: jmp    x != y, 17                 
+    0xa0c3, // 15: mov    isr, null                  
+    0x0114, // 16: jmp    20 [1]                     
+    0xa022, // 17: mov    x, y                       
+    0x40f0, // 18: in     osr, 16                    
+    0x0036, // 19: jmp    !x, 22                     
+    0xa047, // 20: mov    y, osr                     
+    0x008b, // 21: jmp    y--, 11                    
+    0xa04b, // 22: mov    y, !null                   
+    0x4040, // 23: in     y, 32                      
+    0xc030, // 24: irq    wait 0 rel                 
+            //     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program RP2040QTREarlyExit_program = {
+    .instructions = RP2040QTREarlyExit_program_instructions,
+    .length = 25,
+    .origin = -1,
+};
+
+static inline pio_sm_config RP2040QTREarlyExit_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + RP2040QTREarlyExit_wrap_target, offset + RP2040QTREarlyExit_wrap);
+    return c;
+}
+#endif
+
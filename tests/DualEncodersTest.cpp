@@ -0,0 +1,296 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Feeds pin change events through the mocked PIO RX FIFO and DMA channels into RP2040DualEncoders and checks the
+// decoded counts, illegal transitions, and ring buffer overruns. Only one RP2040DualEncoders object can be initialized
+// at a time so all of the tests share one and check the changes in its counts.
+#include "RP2040DualEncoders.h"
+#include "TestHelpers.h"
+
+
+// Exposes the resources that init() claimed so that the test can act as the state machine.
+class DualEncodersUnderTest : public RP2040DualEncoders
+{
+    public:
+        PIO getPio() { return m_pio; }
+        uint32_t getStateMachine() { return m_stateMachine; }
+        uint32_t getDmaChannel() { return m_dmaChannel; }
+        // The interrupt publishes these along with the next event.
+        void presetCounts(int64_t count0, int64_t count1) { m_counts[0] = count0; m_counts[1] = count1; }
+};
+
+static DualEncodersUnderTest g_encoders;
+
+// The state machine side of the events: the current pin states and the number of passes it has made.
+static uint32_t g_pins = 0;
+static uint32_t g_passes = 0;
+
+// Pushes the pin states with the pass counter, as the PIO program does, and lets the DMA channel move it into the
+// ring. The program counts its passes down from 0x3FFFFFF.
+static void pushPins(uint32_t pins)
+{
+    g_pins = pins;
+    g_passes++;
+    g_encoders.getPio()->rxf[g_encoders.getStateMachine()] = (pins << 26) | (~g_passes & ((1 << 26) - 1));
+    bool transferred = mockDmaTransfer(g_encoders.getDmaChannel());
+    if (!transferred)
+    {
+        CHECK ( transferred );
+    }
+}
+
+// Pins for one encoder, in the order that they change when it is counting up. Moving one phase along this sequence
+// counts up or down by one and moving two phases at once is illegal. The expected results below come from this
+// sequence rather than from the library's transition table.
+static const uint32_t g_forwardSequence[4] = { 0, 1, 3, 2 };
+
+static uint32_t encoderShift(uint32_t index)
+{
+    return index * 4;
+}
+
+static uint32_t encoderPins(uint32_t index)
+{
+    return (g_pins >> encoderShift(index)) & 3;
+}
+
+static uint32_t phaseOfPins(uint32_t pins)
+{
+    for (uint32_t phase = 0 ; phase < 4 ; phase++)
+    {
+        if (g_forwardSequence[phase] == pins)
+        {
+            return phase;
+        }
+    }
+    return 0;
+}
+
+static uint32_t withEncoderPins(uint32_t pins, uint32_t index, uint32_t encoderPins)
+{
+    uint32_t shift = encoderShift(index);
+    return (pins & ~(3 << shift)) | (encoderPins << shift);
+}
+
+// Steps each encoder along the sequence by its direction (-1, 0, or 1) with one event per step.
+static void stepEncoders(uint64_t steps, int32_t direction0, int32_t direction1)
+{
+    for (uint64_t i = 0 ; i < steps ; i++)
+    {
+        uint32_t pins = g_pins;
+        pins = withEncoderPins(pins, 0, g_forwardSequence[(phaseOfPins(encoderPins(0)) + direction0) & 3]);
+        pins = withEncoderPins(pins, 1, g_forwardSequence[(phaseOfPins(encoderPins(1)) + direction1) & 3]);
+        pushPins(pins);
+    }
+}
+
+static void testInit()
+{
+    CHECK ( g_encoders.init(8) );
+    CHECK ( mockPioIsEnabled(g_encoders.getPio(), g_encoders.getStateMachine()) );
+    CHECK ( mockDmaIsBusy(g_encoders.getDmaChannel()) );
+
+    // Only one object can be initialized at a time.
+    RP2040DualEncoders second;
+    CHECK ( !second.init(14) );
+
+    // The first event just holds the initial pin states.
+    pushPins(0);
+    int64_t position0 = -1;
+    int64_t position1 = -1;
+    g_encoders.getPositions(position0, position1);
+    CHECK_EQUAL ( 0, position0 );
+    CHECK_EQUAL ( 0, position1 );
+}
+
+struct EncoderState
+{
+    int64_t  positions[2];
+    uint32_t illegalTransitions[2];
+    uint32_t overruns;
+};
+
+static EncoderState readState()
+{
+    EncoderState state;
+    g_encoders.getPositions(state.positions[0], state.positions[1]);
+    for (int32_t i = 0 ; i < 2 ; i++)
+    {
+        state.illegalTransitions[i] = g_encoders.getIllegalTransitions(i);
+    }
+    state.overruns = g_encoders.getEventOverruns();
+    return state;
+}
+
+static void checkChange(const EncoderState& before, int64_t change0, int64_t change1, uint32_t illegal0,
+                        uint32_t illegal1, uint32_t overruns)
+{
+    EncoderState after = readState();
+    CHECK_EQUAL ( change0, after.positions[0] - before.positions[0] );
+    CHECK_EQUAL ( change1, after.positions[1] - before.positions[1] );
+    CHECK_EQUAL ( illegal0, after.illegalTransitions[0] - before.illegalTransitions[0] );
+    CHECK_EQUAL ( illegal1, after.illegalTransitions[1] - before.illegalTransitions[1] );
+    CHECK_EQUAL ( overruns, after.overruns - before.overruns );
+    // The single word counts are published along with the positions.
+    CHECK_EQUAL ( (int32_t)after.positions[0], g_encoders.getCount(0) );
+    CHECK_EQUAL ( (int32_t)after.positions[1], g_encoders.getCount(1) );
+}
+
+static void testEveryTransitionOfBothEncoders()
+{
+    for (uint32_t index = 0 ; index < 2 ; index++)
+    {
+        for (uint32_t previous = 0 ; previous < 4 ; previous++)
+        {
+            for (uint32_t current = 0 ; current < 4 ; current++)
+            {
+                // Count up to the previous pin states and then jump straight to the current ones.
+                while (encoderPins(index) != previous)
+                {
+                    stepEncoders(1, index == 0, index == 1);
+                }
+                EncoderState before = readState();
+                int32_t edgeCount = 0;
+                uint32_t edgeCyclesBefore = 0;
+                g_encoders.getLatestEdge(index, edgeCount, edgeCyclesBefore);
+
+                // The state machine only pushes an event when a pin changes, so one of the ignored pins changes when
+                // the encoder's pins stay the same.
+                uint32_t ignoredPins = (previous == current) ? 0x4 : 0;
+                pushPins(withEncoderPins(g_pins ^ ignoredPins, index, current));
+
+                uint32_t phaseChange = (phaseOfPins(current) - phaseOfPins(previous)) & 3;
+                int64_t change = (phaseChange == 1) ? 1 : (phaseChange == 3) ? -1 : 0;
+                uint32_t illegal = (phaseChange == 2) ? 1 : 0;
+                checkChange(before, index == 0 ? change : 0, index == 1 ? change : 0,
+                            index == 0 ? illegal : 0, index == 1 ? illegal : 0, 0);
+
+                // Only the transitions that counted move the edge time. The first event was at cycle 0 and each
+                // one after it came one pass later.
+                uint32_t edgeCyclesAfter = 0;
+                g_encoders.getLatestEdge(index, edgeCount, edgeCyclesAfter);
+                if (change != 0)
+                {
+                    CHECK_EQUAL ( (g_passes - 1) * (RP2040DualEncoders::CYCLES_PER_PASS +
+                                                    RP2040DualEncoders::EXTRA_CYCLES_PER_EVENT),
+                                  edgeCyclesAfter );
+                }
+                else
+                {
+                    CHECK_EQUAL ( edgeCyclesBefore, edgeCyclesAfter );
+                }
+            }
+        }
+    }
+
+    // Both encoders can change in the same event, and the 2 pins between them are ignored.
+    EncoderState before = readState();
+    stepEncoders(1, 1, -1);
+    pushPins(g_pins ^ 0xC);
+    pushPins(g_pins ^ 0x4);
+    checkChange(before, 1, -1, 0, 0, 0);
+    before = readState();
+    pushPins(g_pins ^ 0x33);
+    checkChange(before, 0, 0, 1, 1, 0);
+}
+
+static void testMoreThan2To31TransfersKeepCounting()
+{
+    // The control channel re-arms the data channel each time it finishes, so running events through it past 2^31
+    // transfers checks that it never stops. The counts start just as close to 2^31 to check that the 64-bit
+    // positions keep going after the 32-bit counts wrap around.
+    const int64_t steps = 4096;
+    const int64_t startCount = (1LL << 31) - steps / 2;
+    uint32_t dmaChannel = g_encoders.getDmaChannel();
+    g_mockDmaChannels[dmaChannel].totalTransfers = (1ULL << 31) - steps / 2;
+    g_encoders.presetCounts(startCount, -startCount);
+
+    stepEncoders(steps, 1, -1);
+
+    CHECK ( mockDmaIsBusy(dmaChannel) );
+    CHECK_EQUAL ( (1ULL << 31) + steps / 2, mockDmaTotalTransfers(dmaChannel) );
+    int64_t position0 = 0;
+    int64_t position1 = 0;
+    g_encoders.getPositions(position0, position1);
+    CHECK_EQUAL ( startCount + steps, position0 );
+    CHECK_EQUAL ( -startCount - steps, position1 );
+    CHECK_EQUAL ( (int32_t)(startCount + steps), g_encoders.getCount(0) );
+    CHECK_EQUAL ( (int32_t)(-startCount - steps), g_encoders.getCount(1) );
+    CHECK ( g_encoders.getCount(0) < 0 );
+    CHECK ( g_encoders.getCount(1) > 0 );
+
+    // Every event came one pass after the last, so the latest edge was 10 cycles after each one before it.
+    int32_t count = 0;
+    uint32_t cycles = 0;
+    g_encoders.getLatestEdge(0, count, cycles);
+    CHECK_EQUAL ( g_encoders.getCount(0), count );
+    CHECK_EQUAL ( (g_passes - 1) * (RP2040DualEncoders::CYCLES_PER_PASS + RP2040DualEncoders::EXTRA_CYCLES_PER_EVENT),
+                  cycles );
+}
+
+// Steps the encoders with the DMA interrupt held off, so that the events pile up in the ring, and then lets the
+// pending interrupt decode them.
+static void stepEncodersWithInterruptHeldOff(uint64_t steps, int32_t direction0, int32_t direction1)
+{
+    irq_set_enabled(DMA_IRQ_0, false);
+    stepEncoders(steps, direction0, direction1);
+    irq_set_enabled(DMA_IRQ_0, true);
+}
+
+static void testRingOverrunsAreCounted()
+{
+    const int64_t ringSize = 256;
+
+    // A ring that is one short of full is decoded as normal.
+    EncoderState before = readState();
+    stepEncodersWithInterruptHeldOff(ringSize - 1, 1, -1);
+    checkChange(before, ringSize - 1, -(ringSize - 1), 0, 0, 0);
+
+    // A full ring is counted as an overrun even though its events are all still there to be decoded.
+    before = readState();
+    stepEncodersWithInterruptHeldOff(ringSize, 1, -1);
+    checkChange(before, ringSize, -ringSize, 0, 0, 1);
+
+    // Beyond that, only the newest events in the ring are decoded. Losing a multiple of 4 steps doesn't change the
+    // pin states so the lost events just go missing from the count.
+    before = readState();
+    stepEncodersWithInterruptHeldOff(2 * ringSize + 3, 1, -1);
+    checkChange(before, ringSize - 1, -(ringSize - 1), 0, 0, 1);
+
+    // Losing 2 more than a multiple of 4 steps makes the jump to the oldest event left in the ring illegal.
+    before = readState();
+    stepEncodersWithInterruptHeldOff(3 * ringSize + 1, 1, -1);
+    checkChange(before, ringSize - 1, -(ringSize - 1), 1, 1, 1);
+
+    // Going around the ring several times before the interrupt runs is still a single overrun.
+    before = readState();
+    stepEncodersWithInterruptHeldOff(10 * ringSize + 3, 1, -1);
+    checkChange(before, ringSize - 1, -(ringSize - 1), 0, 0, 1);
+
+    // The events decode as normal once the interrupt is back.
+    before = readState();
+    stepEncoders(100 * ringSize, 1, -1);
+    checkChange(before, 100 * ringSize, -100 * ringSize, 0, 0, 0);
+}
+
+int main(void)
+{
+    testInit();
+    testEveryTransitionOfBothEncoders();
+    testMoreThan2To31TransfersKeepCounting();
+    // This one loses events on purpose so it has to come after the tests which check the edge times.
+    testRingOverrunsAreCounted();
+
+    return reportTestResults("DualEncodersTest");
+}
@@ -0,0 +1,201 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Checks the calibrated line sensor values computed with the precomputed reciprocals in LineSensors::CalibrationData
+// against an exact divide, and compares their speed with the divide that readCalibrated() used to do for every
+// sensor. The host's divider is much quicker relative to a multiply than the RP2040's so the speedup on the robot is
+// larger than the one reported here.
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "Pololu3piPlus2040LineSensors.h"
+#include "TestHelpers.h"
+
+using namespace Pololu3piPlus2040;
+
+
+static const uint8_t sensorCount = LINE_SENSOR_COUNT;
+
+// The calibrated value that readCalibrated() used to compute with a divide.
+static uint16_t divideCalibrateValue(const LineSensors::CalibrationData& calibration, uint8_t i, uint16_t rawValue)
+{
+    uint16_t calmin = calibration.minimum.vals[i];
+    uint16_t calmax = calibration.maximum.vals[i];
+    uint16_t denominator = calmax - calmin;
+    int32_t  value = 0;
+
+    if (denominator != 0)
+    {
+        value = (((int32_t)rawValue) - calmin) * 1000 / denominator;
+    }
+    if (value < 0)
+    {
+        value = 0;
+    }
+    else if (value > 1000)
+    {
+        value = 1000;
+    }
+    return value;
+}
+
+static void setRange(LineSensors::CalibrationData& calibration, uint8_t i, uint16_t minimum, uint16_t maximum)
+{
+    calibration.minimum.vals[i] = minimum;
+    calibration.maximum.vals[i] = maximum;
+    calibration.updateScale(i);
+}
+
+// The readings are exact for ranges up to 2048, which covers the default 1024 tick timeout, and at most 1 high for
+// the larger ranges that longer timeouts or faster tick frequencies allow.
+static void checkRange(LineSensors::CalibrationData& calibration, uint16_t range, uint32_t offsetStep,
+                       uint32_t& maxError)
+{
+    const uint16_t minimum = 7;
+    setRange(calibration, 0, minimum, minimum + range);
+    for (uint32_t offset = 1 ; offset < range ; offset += offsetStep)
+    {
+        uint32_t expected = offset * 1000 / range;
+        uint32_t actual = calibration.calibrateValue(0, minimum + offset);
+        uint32_t error = actual - expected;
+        if (actual < expected || error > (range <= 2048 ? 0u : 1u))
+        {
+            printf("range %u offset %u: expected %u but was %u\n", range, offset, expected, actual);
+            CHECK ( false );
+            return;
+        }
+        if (error > maxError)
+        {
+            maxError = error;
+        }
+    }
+    // The ends of the range clamp to 0 and 1000.
+    CHECK_EQUAL ( 0, calibration.calibrateValue(0, 0) );
+    CHECK_EQUAL ( 0, calibration.calibrateValue(0, minimum) );
+    CHECK_EQUAL ( 1000, calibration.calibrateValue(0, minimum + range) );
+    CHECK_EQUAL ( 1000, calibration.calibrateValue(0, 0xFFFF) );
+}
+
+static void testAccuracy()
+{
+    LineSensors::CalibrationData calibration;
+    uint32_t maxError = 0;
+
+    // Every offset of every range that the default and doubled timeouts can produce, then a sample of the offsets
+    // for the rest of the 16-bit ranges.
+    for (uint32_t range = 1 ; range <= 4096 ; range++)
+    {
+        checkRange(calibration, range, 1, maxError);
+    }
+    for (uint32_t range = 4097 ; range <= 0xFFF0 ; range += 13)
+    {
+        checkRange(calibration, range, 97, maxError);
+    }
+    printf("Largest error against an exact divide: %u\n", maxError);
+
+    // Nothing is calibrated for a sensor whose minimum and maximum are the same.
+    setRange(calibration, 1, 500, 500);
+    CHECK_EQUAL ( 0, calibration.calibrateValue(1, 400) );
+    CHECK_EQUAL ( 0, calibration.calibrateValue(1, 600) );
+}
+
+static void testScalesFollowCalibrationChanges()
+{
+    LineSensors::CalibrationData calibration;
+    for (uint8_t i = 0 ; i < sensorCount ; i++)
+    {
+        calibration.minimum.vals[i] = 100 + i;
+        calibration.maximum.vals[i] = 900 - i * 50;
+    }
+    calibration.updateScales();
+    for (uint8_t i = 0 ; i < sensorCount ; i++)
+    {
+        CHECK_EQUAL ( divideCalibrateValue(calibration, i, 450), calibration.calibrateValue(i, 450) );
+    }
+
+    // Reads only use the scales, so they have to be updated along with the minimum and maximum.
+    for (uint8_t i = 0 ; i < sensorCount ; i++)
+    {
+        calibration.maximum.vals[i] = 1000 - i * 30;
+    }
+    calibration.updateScales();
+    for (uint8_t i = 0 ; i < sensorCount ; i++)
+    {
+        CHECK_EQUAL ( divideCalibrateValue(calibration, i, 450), calibration.calibrateValue(i, 450) );
+    }
+}
+
+template<typename Calibrate>
+static double measureNsPerRead(const LineSensors::CalibrationData& calibration,
+                               const std::vector<LineSensorReadings>& reads, Calibrate calibrate, uint32_t& checksum)
+{
+    const uint32_t passes = 200;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t pass = 0 ; pass < passes ; pass++)
+    {
+        for (const LineSensorReadings& raw : reads)
+        {
+            for (uint8_t i = 0 ; i < sensorCount ; i++)
+            {
+                checksum += calibrate(calibration, i, raw.vals[i]);
+            }
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ((double)passes * reads.size());
+}
+
+static void benchmarkCalibratedReads()
+{
+    LineSensors::CalibrationData calibration;
+    for (uint8_t i = 0 ; i < sensorCount ; i++)
+    {
+        setRange(calibration, i, 40 + rand() % 80, 600 + rand() % 424);
+    }
+    std::vector<LineSensorReadings> reads(2000);
+    for (LineSensorReadings& raw : reads)
+    {
+        for (uint8_t i = 0 ; i < sensorCount ; i++)
+        {
+            raw.vals[i] = rand() % (QTRSensors::TIMEOUT + 1);
+        }
+    }
+
+    uint32_t divideChecksum = 0;
+    uint32_t reciprocalChecksum = 0;
+    double divideNs = measureNsPerRead(calibration, reads, divideCalibrateValue, divideChecksum);
+    double reciprocalNs = measureNsPerRead(calibration, reads,
+                                           [](const LineSensors::CalibrationData& calibration, uint8_t i, uint16_t raw)
+                                           {
+                                               return calibration.calibrateValue(i, raw);
+                                           },
+                                           reciprocalChecksum);
+    CHECK_EQUAL ( divideChecksum, reciprocalChecksum );
+
+    printf("Calibrating %u sensors: divide %.1f ns/read, reciprocal %.1f ns/read (%.1fx)\n",
+           sensorCount, divideNs, reciprocalNs, divideNs / reciprocalNs);
+}
+
+int main(void)
+{
+    srand(1);
+    testAccuracy();
+    testScalesFollowCalibrationChanges();
+    benchmarkCalibratedReads();
+
+    return reportTestResults("LineCalibrationBenchmark");
+}
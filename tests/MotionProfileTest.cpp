@@ -0,0 +1,182 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Runs MotionProfile moves with and without a jerk limit and checks that they land exactly on their targets without
+// overshooting or exceeding the velocity, acceleration, and jerk limits along the way.
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include "Pololu3piPlus2040MotionProfile.h"
+#include "TestHelpers.h"
+
+using namespace Pololu3piPlus2040;
+
+
+// The profile is updated every millisecond.
+static const int32_t updatesPerSecond = 1000;
+static const int32_t maxUpdates = 200000;
+
+struct Limits
+{
+    int32_t velocity;
+    int32_t acceleration;
+    int32_t jerk;
+};
+
+struct MoveResult
+{
+    int32_t updates;
+    int64_t finalPosition;
+    int64_t overshoot;
+    // Fastest speed away from the target, which is only needed when the move starts out too fast to stop in time.
+    int32_t maxReverseVelocity;
+    int32_t maxVelocity;
+    int32_t maxAcceleration;
+    int32_t maxJerk;
+};
+
+static MoveResult runMove(const Limits& limits, int64_t start, int64_t target, int32_t startVelocity)
+{
+    MotionProfile profile;
+    profile.setLimits(limits.velocity, limits.acceleration, limits.jerk);
+    profile.reset(start, startVelocity);
+    profile.moveTo(target);
+
+    MoveResult result = { 0, 0, 0, 0, 0, 0, 0 };
+    int32_t lastAcceleration = 0;
+    for (result.updates = 0 ; result.updates < maxUpdates && !profile.isDone() ; result.updates++)
+    {
+        profile.update();
+
+        int32_t velocity = profile.getVelocity();
+        int32_t acceleration = profile.getAcceleration();
+        int32_t jerk = abs(acceleration - lastAcceleration) * updatesPerSecond;
+        int32_t reverseVelocity = (target > start) ? -velocity : velocity;
+        lastAcceleration = acceleration;
+        result.maxReverseVelocity = std::max(result.maxReverseVelocity, reverseVelocity);
+        result.maxVelocity = std::max(result.maxVelocity, abs(velocity));
+        result.maxAcceleration = std::max(result.maxAcceleration, abs(acceleration));
+        result.maxJerk = std::max(result.maxJerk, jerk);
+
+        int64_t position = profile.getPosition();
+        int64_t overshoot = (target > start) ? position - target : target - position;
+        result.overshoot = std::max(result.overshoot, overshoot);
+    }
+    result.finalPosition = profile.getPosition();
+    CHECK_EQUAL ( 0, profile.getVelocity() );
+    CHECK_EQUAL ( 0, profile.getAcceleration() );
+    return result;
+}
+
+static void checkMove(const Limits& limits, int64_t start, int64_t target)
+{
+    MoveResult result = runMove(limits, start, target, 0);
+    printf("v=%d a=%d j=%d %lld -> %lld: %d updates, final %lld, max v=%d a=%d j=%d, overshoot %lld, reverse v=%d\n",
+           limits.velocity, limits.acceleration, limits.jerk, (long long)start, (long long)target, result.updates,
+           (long long)result.finalPosition, result.maxVelocity, result.maxAcceleration, result.maxJerk,
+           (long long)result.overshoot, result.maxReverseVelocity);
+
+    CHECK ( result.updates < maxUpdates );
+    CHECK_EQUAL ( target, result.finalPosition );
+    CHECK ( result.overshoot <= 0 );
+    CHECK_EQUAL ( 0, result.maxReverseVelocity );
+    CHECK ( result.maxVelocity <= limits.velocity );
+    CHECK ( result.maxAcceleration <= limits.acceleration );
+    if (limits.jerk != 0)
+    {
+        // The acceleration is only reported to the nearest count/s^2 so allow for that rounding.
+        CHECK ( result.maxJerk <= limits.jerk + 2 * updatesPerSecond );
+    }
+}
+
+static void testMovesLandExactlyWithoutOvershoot()
+{
+    const Limits limits[] =
+    {
+        { 3000, 6000,      0 },
+        { 3000, 6000,  20000 },
+        { 3000, 6000,  60000 },
+        { 3000, 6000, 200000 },
+        {  800,  500,      0 },
+        {  800,  500,  60000 },
+        { 3000, 6000,   5000 },
+    };
+    const int64_t moves[][2] =
+    {
+        {   0,   1000 },
+        {   0,     10 },
+        {   0,      3 },
+        {   0,  -5000 },
+        { 100, 100000 },
+        { -50,    -49 },
+        {   0,     37 },
+        {   0,    250 },
+    };
+    for (const Limits& limit : limits)
+    {
+        for (const int64_t* move : moves)
+        {
+            checkMove(limit, move[0], move[1]);
+        }
+    }
+}
+
+static void testMoveWhileAlreadyMovingStillLands()
+{
+    // Moving too fast toward a target to stop before it, so the profile has to overshoot and come back.
+    const Limits limits = { 3000, 6000, 60000 };
+    MoveResult result = runMove(limits, 0, 200, 2000);
+    CHECK ( result.updates < maxUpdates );
+    CHECK_EQUAL ( 200, result.finalPosition );
+    CHECK ( result.maxJerk <= limits.jerk + 2 * updatesPerSecond );
+
+    // Moving away from the target to start with.
+    result = runMove(limits, 0, 500, -1500);
+    CHECK ( result.updates < maxUpdates );
+    CHECK_EQUAL ( 500, result.finalPosition );
+}
+
+static void testVelocityMode()
+{
+    MotionProfile profile;
+    profile.setLimits(3000, 6000, 60000);
+    profile.moveAtVelocity(2500);
+    int32_t updates;
+    for (updates = 0 ; updates < 5000 && !profile.isDone() ; updates++)
+    {
+        profile.update();
+        CHECK ( profile.getVelocity() <= 2500 );
+    }
+    CHECK ( profile.isDone() );
+    CHECK_EQUAL ( 2500, profile.getVelocity() );
+    CHECK_EQUAL ( 0, profile.getAcceleration() );
+
+    // Targets beyond the maximum velocity are limited to it.
+    profile.moveAtVelocity(-10000);
+    for (updates = 0 ; updates < 5000 && !profile.isDone() ; updates++)
+    {
+        profile.update();
+    }
+    CHECK ( profile.isDone() );
+    CHECK_EQUAL ( -3000, profile.getVelocity() );
+}
+
+int main(void)
+{
+    testMovesLandExactlyWithoutOvershoot();
+    testMoveWhileAlreadyMovingStillLands();
+    testVelocityMode();
+
+    return reportTestResults("MotionProfileTest");
+}
@@ -0,0 +1,447 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Cycle level simulator for a single RP2040 PIO state machine so that the assembled PIO programs in ../src can be
+// tested on the host. It covers the subset of the instruction set and configuration used by this library: no
+// side-set, pin numbers relative to the configured bases, and FIFOs that the test drains as it goes.
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <deque>
+#include <functional>
+
+
+class PioStateMachine
+{
+    public:
+        // Called to get the level of the 32 pins, relative to the IN pin base, each time the program reads them.
+        typedef std::function<uint32_t(const PioStateMachine& sm)> PinReader;
+
+        PioStateMachine(const uint16_t* pInstructions, uint32_t length, uint32_t wrapTarget, uint32_t wrap)
+        {
+            assert ( length <= 32 );
+            for (uint32_t i = 0 ; i < length ; i++)
+            {
+                m_instructions[i] = pInstructions[i];
+            }
+            m_wrapTarget = wrapTarget;
+            m_wrap = wrap;
+        }
+
+        void setInShift(bool shiftRight, bool autoPush, uint32_t threshold)
+        {
+            m_inShiftRight = shiftRight;
+            m_autoPush = autoPush;
+            m_pushThreshold = threshold;
+        }
+        void setOutShift(bool shiftRight)
+        {
+            m_outShiftRight = shiftRight;
+        }
+        void setOutPinCount(uint32_t count)
+        {
+            m_outPinCount = count;
+        }
+        void setFifoDepths(uint32_t rxDepth, uint32_t txDepth)
+        {
+            m_rxDepth = rxDepth;
+            m_txDepth = txDepth;
+        }
+        void setPinReader(PinReader reader)
+        {
+            m_pinReader = reader;
+        }
+        void setPins(uint32_t values, uint32_t mask)
+        {
+            m_pinValues = (m_pinValues & ~mask) | (values & mask);
+        }
+
+        // Executes a single instruction right away, like pio_sm_exec().
+        void exec(uint16_t instruction)
+        {
+            bool jumped = false;
+            bool executed = execute(instruction, jumped);
+            assert ( executed );
+            (void)executed;
+        }
+
+        // Runs the state machine for one clock cycle.
+        void step()
+        {
+            m_cycle++;
+            if (m_delay > 0)
+            {
+                m_delay--;
+                return;
+            }
+
+            uint16_t instruction = m_instructions[m_pc];
+            bool jumped = false;
+            m_stalled = !execute(instruction, jumped);
+            if (m_stalled)
+            {
+                return;
+            }
+            if (!jumped)
+            {
+                m_pc = (m_pc == m_wrap) ? m_wrapTarget : (m_pc + 1) & 31;
+            }
+            m_delay = (instruction >> 8) & 31;
+        }
+
+        void putTx(uint32_t value)
+        {
+            assert ( m_tx.size() < m_txDepth );
+            m_tx.push_back(value);
+        }
+        bool isRxEmpty() const
+        {
+            return m_rx.empty();
+        }
+        uint32_t getRx()
+        {
+            assert ( !m_rx.empty() );
+            uint32_t value = m_rx.front();
+            m_rx.pop_front();
+            return value;
+        }
+
+        bool isIrqSet(uint32_t index) const
+        {
+            return (m_irqFlags & (1 << index)) != 0;
+        }
+        void clearIrq(uint32_t index)
+        {
+            m_irqFlags &= ~(1 << index);
+        }
+
+        bool isStalled() const          { return m_stalled; }
+        uint64_t getCycle() const       { return m_cycle; }
+        uint32_t getPinDirs() const     { return m_pinDirs; }
+        uint32_t getPinValues() const   { return m_pinValues; }
+        uint32_t getPc() const          { return m_pc; }
+        void setPc(uint32_t pc)         { m_pc = pc & 31; }
+
+    protected:
+        enum { JMP = 0, WAIT, IN, OUT, PUSH_PULL, MOV, IRQ, SET };
+
+        uint32_t readPins() const
+        {
+            return m_pinReader ? m_pinReader(*this) : 0;
+        }
+
+        void writePins(uint32_t& pins, uint32_t data, uint32_t count)
+        {
+            if (count > m_outPinCount)
+            {
+                count = m_outPinCount;
+            }
+            uint32_t mask = (count >= 32) ? 0xFFFFFFFF : (1u << count) - 1;
+            pins = (pins & ~mask) | (data & mask);
+        }
+
+        uint32_t irqIndex(uint32_t index) const
+        {
+            // The REL bit adds the state machine number, which is always 0 here, modulo 4.
+            return index & 7;
+        }
+
+        bool shiftIn(uint32_t data, uint32_t count)
+        {
+            if (m_autoPush && m_isrCount >= m_pushThreshold && !push(true))
+            {
+                return false;
+            }
+            uint32_t mask = (count >= 32) ? 0xFFFFFFFF : (1u << count) - 1;
+            data &= mask;
+            if (count >= 32)
+            {
+                m_isr = data;
+            }
+            else if (m_inShiftRight)
+            {
+                m_isr = (m_isr >> count) | (data << (32 - count));
+            }
+            else
+            {
+                m_isr = (m_isr << count) | data;
+            }
+            m_isrCount += count;
+            if (m_isrCount > 32)
+            {
+                m_isrCount = 32;
+            }
+            if (m_autoPush && m_isrCount >= m_pushThreshold)
+            {
+                // If the FIFO is full then the push happens before the next IN instead.
+                push(false);
+            }
+            return true;
+        }
+
+        uint32_t shiftOut(uint32_t count)
+        {
+            uint32_t data;
+            if (count >= 32)
+            {
+                data = m_osr;
+                m_osr = 0;
+            }
+            else if (m_outShiftRight)
+            {
+                data = m_osr & ((1u << count) - 1);
+                m_osr >>= count;
+            }
+            else
+            {
+                data = m_osr >> (32 - count);
+                m_osr <<= count;
+            }
+            m_osrCount += count;
+            if (m_osrCount > 32)
+            {
+                m_osrCount = 32;
+            }
+            return data;
+        }
+
+        bool push(bool block)
+        {
+            if (m_rx.size() >= m_rxDepth)
+            {
+                return !block;
+            }
+            m_rx.push_back(m_isr);
+            m_isr = 0;
+            m_isrCount = 0;
+            return true;
+        }
+
+        uint32_t movSource(uint32_t source) const
+        {
+            switch (source)
+            {
+                case 0: return readPins();
+                case 1: return m_x;
+                case 2: return m_y;
+                case 3: return 0;
+                case 6: return m_isr;
+                case 7: return m_osr;
+                default: assert ( !"Unsupported MOV source" ); return 0;
+            }
+        }
+
+        // Returns false if the instruction stalled and needs to be run again on the next cycle.
+        bool execute(uint16_t instruction, bool& jumped)
+        {
+            uint32_t opcode = instruction >> 13;
+            uint32_t arg1 = (instruction >> 5) & 7;
+            uint32_t arg2 = instruction & 31;
+
+            switch (opcode)
+            {
+                case JMP:
+                {
+                    bool take = false;
+                    switch (arg1)
+                    {
+                        case 0: take = true; break;
+                        case 1: take = (m_x == 0); break;
+                        case 2: take = (m_x != 0); m_x--; break;
+                        case 3: take = (m_y == 0); break;
+                        case 4: take = (m_y != 0); m_y--; break;
+                        case 5: take = (m_x != m_y); break;
+                        case 6: take = (readPins() & 1) != 0; break;
+                        case 7: take = (m_osrCount < 32); break;
+                    }
+                    if (take)
+                    {
+                        m_pc = arg2;
+                        jumped = true;
+                    }
+                    return true;
+                }
+                case WAIT:
+                {
+                    uint32_t polarity = (instruction >> 7) & 1;
+                    uint32_t source = (instruction >> 5) & 3;
+                    if (source == 2)
+                    {
+                        uint32_t index = irqIndex(arg2);
+                        bool set = isIrqSet(index);
+                        if (polarity && set)
+                        {
+                            clearIrq(index);
+                        }
+                        return set == (polarity != 0);
+                    }
+                    return ((readPins() >> arg2) & 1) == polarity;
+                }
+                case IN:
+                {
+                    uint32_t count = arg2 ? arg2 : 32;
+                    return shiftIn(movSource(arg1), count);
+                }
+                case OUT:
+                {
+                    uint32_t count = arg2 ? arg2 : 32;
+                    uint32_t data = shiftOut(count);
+                    switch (arg1)
+                    {
+                        case 0: writePins(m_pinValues, data, count); break;
+                        case 1: m_x = data; break;
+                        case 2: m_y = data; break;
+                        case 3: break;
+                        case 4: writePins(m_pinDirs, data, count); break;
+                        case 5: m_pc = data & 31; jumped = true; break;
+                        case 6: m_isr = data; m_isrCount = count; break;
+                        default: assert ( !"Unsupported OUT destination" ); break;
+                    }
+                    return true;
+                }
+                case PUSH_PULL:
+                {
+                    bool ifFullOrEmpty = (instruction >> 6) & 1;
+                    bool block = (instruction >> 5) & 1;
+                    if (instruction & 0x80)
+                    {
+                        if (ifFullOrEmpty && m_osrCount < 32)
+                        {
+                            return true;
+                        }
+                        if (m_tx.empty())
+                        {
+                            if (block)
+                            {
+                                return false;
+                            }
+                            m_osr = m_x;
+                        }
+                        else
+                        {
+                            m_osr = m_tx.front();
+                            m_tx.pop_front();
+                        }
+                        m_osrCount = 0;
+                        return true;
+                    }
+                    if (ifFullOrEmpty && m_isrCount < m_pushThreshold)
+                    {
+                        return true;
+                    }
+                    return push(block);
+                }
+                case MOV:
+                {
+                    uint32_t operation = (instruction >> 3) & 3;
+                    uint32_t value = movSource(instruction & 7);
+                    if (operation == 1)
+                    {
+                        value = ~value;
+                    }
+                    else if (operation == 2)
+                    {
+                        uint32_t reversed = 0;
+                        for (uint32_t i = 0 ; i < 32 ; i++)
+                        {
+                            reversed |= ((value >> i) & 1) << (31 - i);
+                        }
+                        value = reversed;
+                    }
+                    switch (arg1)
+                    {
+                        case 0: writePins(m_pinValues, value, 32); break;
+                        case 1: m_x = value; break;
+                        case 2: m_y = value; break;
+                        case 5: m_pc = value & 31; jumped = true; break;
+                        case 6: m_isr = value; m_isrCount = 0; break;
+                        case 7: m_osr = value; m_osrCount = 0; break;
+                        default: assert ( !"Unsupported MOV destination" ); break;
+                    }
+                    return true;
+                }
+                case IRQ:
+                {
+                    bool clear = (instruction >> 6) & 1;
+                    bool wait = (instruction >> 5) & 1;
+                    uint32_t index = irqIndex(arg2);
+                    if (clear)
+                    {
+                        clearIrq(index);
+                        return true;
+                    }
+                    if (!wait)
+                    {
+                        m_irqFlags |= 1 << index;
+                        return true;
+                    }
+                    if (!m_irqWaiting)
+                    {
+                        m_irqFlags |= 1 << index;
+                        m_irqWaiting = true;
+                        return false;
+                    }
+                    if (isIrqSet(index))
+                    {
+                        return false;
+                    }
+                    m_irqWaiting = false;
+                    return true;
+                }
+                case SET:
+                {
+                    switch (arg1)
+                    {
+                        case 0: writePins(m_pinValues, arg2, 5); break;
+                        case 1: m_x = arg2; break;
+                        case 2: m_y = arg2; break;
+                        case 4: writePins(m_pinDirs, arg2, 5); break;
+                        default: assert ( !"Unsupported SET destination" ); break;
+                    }
+                    return true;
+                }
+            }
+            return true;
+        }
+
+        uint16_t            m_instructions[32] = { 0 };
+        uint32_t            m_wrapTarget;
+        uint32_t            m_wrap;
+        uint32_t            m_pc = 0;
+        uint32_t            m_x = 0;
+        uint32_t            m_y = 0;
+        uint32_t            m_isr = 0;
+        uint32_t            m_isrCount = 0;
+        uint32_t            m_osr = 0;
+        uint32_t            m_osrCount = 32;
+        uint32_t            m_delay = 0;
+        uint64_t            m_cycle = 0;
+        bool                m_stalled = false;
+        bool                m_irqWaiting = false;
+        uint32_t            m_irqFlags = 0;
+
+        bool                m_inShiftRight = true;
+        bool                m_autoPush = false;
+        uint32_t            m_pushThreshold = 32;
+        bool                m_outShiftRight = true;
+        uint32_t            m_outPinCount = 32;
+        uint32_t            m_rxDepth = 4;
+        uint32_t            m_txDepth = 4;
+        uint32_t            m_pinValues = 0;
+        uint32_t            m_pinDirs = 0;
+        PinReader           m_pinReader;
+        std::deque<uint32_t> m_rx;
+        std::deque<uint32_t> m_tx;
+};
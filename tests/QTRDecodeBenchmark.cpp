@@ -0,0 +1,188 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Records the FIFO event streams that the RP2040QTR PIO program pushes for a few kinds of surface and replays them
+// through the original decode loop from QTRSensors::read(), which walked all 7 bits of every event, and through
+// QTRSensors::decodeEvent(), which only visits the sensors that just discharged. Checks that both give the same
+// readings and reports how long each takes per frame.
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "QTRProgramSimulator.h"
+#include "RP2040QTR.h"
+#include "TestHelpers.h"
+
+using namespace Pololu3piPlus2040;
+
+
+typedef std::vector<uint32_t> EventStream;
+
+// Exposes the protected decoder of the library's QTRSensors class.
+class QTRSensorsDecoder : public QTRSensors
+{
+    public:
+        void decodeStream(const EventStream& events, QTRSensorReadings& readings)
+        {
+            uint32_t pendingPins;
+            initReadings(readings, pendingPins);
+            for (uint32_t val : events)
+            {
+                if (val == 0xFFFFFFFF)
+                {
+                    break;
+                }
+                decodeEvent(val, readings, pendingPins);
+            }
+        }
+};
+
+// The decode loop from QTRSensors::read() before the decoder was reworked.
+static void originalDecodeStream(const EventStream& events, QTRSensorReadings& readings)
+{
+    const uint32_t TIMEOUT = QTRSensors::TIMEOUT;
+    for (size_t i = 0 ; i < sizeof(readings.raw)/sizeof(readings.raw[0]) ; i++)
+    {
+        readings.raw[i] = TIMEOUT;
+    }
+
+    uint32_t lastPinStates = 0x7F;
+    for (uint32_t val : events)
+    {
+        if (val == 0xFFFFFFFF)
+        {
+            break;
+        }
+        uint32_t currPinStates = (val >> 16) & 0x7F;
+        uint32_t currTime = val & 0xFFFF;
+        uint32_t newZeros = lastPinStates ^ currPinStates;
+        for (int i = 0 ; i < 7 ; i++)
+        {
+            if ((newZeros & (1 << i)) && readings.raw[i] == TIMEOUT)
+            {
+                readings.raw[i] = TIMEOUT - currTime;
+            }
+        }
+        lastPinStates = currPinStates;
+    }
+}
+
+struct Surface
+{
+    const char* pName;
+    // Range of discharge times for the sensors over this surface, in ticks.
+    uint32_t    minTicks;
+    uint32_t    maxTicks;
+    // Number of sensors which are over a dark line and take much longer.
+    uint32_t    darkSensors;
+};
+
+static std::vector<EventStream> recordStreams(const Surface& surface, uint32_t frameCount)
+{
+    const uint32_t timeoutTicks = QTRSensors::TIMEOUT;
+    const uint32_t chargeTicks = QTRSensors::CHARGE_TIME;
+    QTRProgram program = createStandard();
+    std::vector<EventStream> streams;
+
+    for (uint32_t frame = 0 ; frame < frameCount ; frame++)
+    {
+        uint32_t discharge[sensorCount];
+        for (uint32_t i = 0 ; i < sensorCount ; i++)
+        {
+            discharge[i] = surface.minTicks + rand() % (surface.maxTicks - surface.minTicks + 1);
+        }
+        uint32_t firstDark = rand() % sensorCount;
+        for (uint32_t i = 0 ; i < surface.darkSensors ; i++)
+        {
+            discharge[(firstDark + i) % sensorCount] = 700 + rand() % 600;
+        }
+        ReadResult result = program.read(discharge, allSensorsMask, timeoutTicks, chargeTicks * 8);
+        CHECK ( result.completed );
+        streams.push_back(program.getEvents());
+    }
+    return streams;
+}
+
+template<typename Decoder>
+static double measureNsPerFrame(const std::vector<EventStream>& streams, Decoder decoder, uint32_t& checksum)
+{
+    const uint32_t passes = 200;
+    QTRSensorReadings readings;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t pass = 0 ; pass < passes ; pass++)
+    {
+        for (const EventStream& events : streams)
+        {
+            decoder(events, readings);
+            checksum += readings.raw[pass % LIGHT_SENSOR_COUNT];
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ((double)passes * streams.size());
+}
+
+static void benchmarkSurface(QTRSensorsDecoder& qtr, const Surface& surface)
+{
+    std::vector<EventStream> streams = recordStreams(surface, 500);
+
+    size_t eventCount = 0;
+    for (const EventStream& events : streams)
+    {
+        QTRSensorReadings original;
+        QTRSensorReadings reworked;
+        originalDecodeStream(events, original);
+        qtr.decodeStream(events, reworked);
+        for (uint32_t i = 0 ; i < LIGHT_SENSOR_COUNT ; i++)
+        {
+            CHECK_EQUAL ( original.raw[i], reworked.raw[i] );
+        }
+        eventCount += events.size();
+    }
+
+    uint32_t originalChecksum = 0;
+    uint32_t reworkedChecksum = 0;
+    double originalNs = measureNsPerFrame(streams, originalDecodeStream, originalChecksum);
+    double reworkedNs = measureNsPerFrame(streams,
+                                          [&qtr](const EventStream& events, QTRSensorReadings& readings)
+                                          {
+                                              qtr.decodeStream(events, readings);
+                                          },
+                                          reworkedChecksum);
+    CHECK_EQUAL ( originalChecksum, reworkedChecksum );
+
+    printf("%-14s %5.1f events/frame: original %6.1f ns/frame, decodeEvent %6.1f ns/frame (%.1fx)\n",
+           surface.pName, (double)eventCount / streams.size(), originalNs, reworkedNs, originalNs / reworkedNs);
+}
+
+int main(void)
+{
+    const Surface surfaces[] =
+    {
+        { "White",         20,  120, 0 },
+        { "Line",          20,  120, 2 },
+        { "Dark",         500, 1023, 0 },
+        { "Mixed",          1, 1200, 0 },
+    };
+    QTRSensorsDecoder qtr;
+
+    srand(1);
+    for (const Surface& surface : surfaces)
+    {
+        benchmarkSurface(qtr, surface);
+    }
+
+    return reportTestResults("QTRDecodeBenchmark");
+}
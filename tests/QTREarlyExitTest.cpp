@@ -0,0 +1,158 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Runs the RP2040QTR and RP2040QTREarlyExit PIO programs against simulated sensor capacitors and checks that the early
+// exit variant returns the same readings as the standard program while finishing as soon as the sensors discharge.
+#include <stdio.h>
+#include <stdlib.h>
+#include "QTRProgramSimulator.h"
+#include "TestHelpers.h"
+
+
+static void checkReadings(const char* pName, const ReadResult& result, const uint32_t dischargeTicks[sensorCount],
+                          uint32_t mask, uint32_t timeoutTicks)
+{
+    CHECK ( result.completed );
+    for (uint32_t i = 0 ; i < sensorCount ; i++)
+    {
+        if ((mask & (1 << i)) == 0)
+        {
+            CHECK_EQUAL ( 0, result.readings[i] );
+            continue;
+        }
+        uint32_t expected = dischargeTicks[i] < timeoutTicks ? dischargeTicks[i] : timeoutTicks;
+        int32_t error = (int32_t)result.readings[i] - (int32_t)expected;
+        if (error < -1 || error > 1)
+        {
+            printf("%s: sensor %u read %u but discharged after %u ticks\n", pName, i, result.readings[i], expected);
+            CHECK ( false );
+        }
+    }
+}
+
+static void testSameReadingsAsStandardProgram()
+{
+    const uint32_t timeoutTicks = 1024;
+    const uint32_t chargeTicks = 32;
+    QTRProgram standard = createStandard();
+    QTRProgram earlyExit = createEarlyExit();
+
+    srand(1);
+    for (int trial = 0 ; trial < 200 ; trial++)
+    {
+        uint32_t discharge[sensorCount];
+        for (uint32_t i = 0 ; i < sensorCount ; i++)
+        {
+            // Mostly bright surfaces which discharge quickly, with some dark ones and some sensors timing out.
+            switch (rand() % 4)
+            {
+                case 0:  discharge[i] = 1 + rand() % 1200; break;
+                case 1:  discharge[i] = (rand() % 8) ? 1 + rand() % 1023 : neverDischarges; break;
+                default: discharge[i] = 20 + rand() % 100; break;
+            }
+        }
+        uint32_t mask = (trial % 5 == 0) ? (rand() & allSensorsMask) : allSensorsMask;
+        if (mask == 0)
+        {
+            // No sensors means nothing to discharge, so even the early exit program waits for the timeout.
+            mask = 1;
+        }
+
+        uint64_t standardStart = standard.getCycle();
+        ReadResult standardResult = standard.read(discharge, mask, timeoutTicks, chargeTicks * 8);
+        uint64_t earlyExitStart = earlyExit.getCycle();
+        ReadResult earlyExitResult = earlyExit.read(discharge, mask, timeoutTicks, chargeTicks * 9);
+
+        checkReadings("RP2040QTR", standardResult, discharge, mask, timeoutTicks);
+        checkReadings("RP2040QTREarlyExit", earlyExitResult, discharge, mask, timeoutTicks);
+        for (uint32_t i = 0 ; i < sensorCount ; i++)
+        {
+            CHECK_EQUAL ( standardResult.readings[i], earlyExitResult.readings[i] );
+        }
+
+        // The early exit read should end within a couple of ticks of the last active sensor discharging, and the
+        // standard one only once the timeout has been counted down.
+        uint32_t lastTick = 0;
+        for (uint32_t i = 0 ; i < sensorCount ; i++)
+        {
+            if ((mask & (1 << i)) && discharge[i] > lastTick)
+            {
+                lastTick = discharge[i] < timeoutTicks ? discharge[i] : timeoutTicks;
+            }
+        }
+        uint64_t standardTicks = (standardResult.endCycle - standardStart) / 8;
+        uint64_t earlyExitTicks = (earlyExitResult.endCycle - earlyExitStart) / 9;
+        CHECK ( standardTicks >= chargeTicks + timeoutTicks );
+        CHECK ( standardTicks <= chargeTicks + timeoutTicks + 3 );
+        CHECK ( earlyExitTicks <= chargeTicks + lastTick + 3 );
+    }
+}
+
+static void testBrightSurfaceIsMuchQuicker()
+{
+    const uint32_t timeoutTicks = 1024;
+    const uint32_t chargeTicks = 32;
+    const uint32_t discharge[sensorCount] = { 60, 75, 90, 100, 80, 70, 65 };
+    QTRProgram standard = createStandard();
+    QTRProgram earlyExit = createEarlyExit();
+
+    uint64_t standardStart = standard.getCycle();
+    ReadResult standardResult = standard.read(discharge, allSensorsMask, timeoutTicks, chargeTicks * 8);
+    uint64_t earlyExitStart = earlyExit.getCycle();
+    ReadResult earlyExitResult = earlyExit.read(discharge, allSensorsMask, timeoutTicks, chargeTicks * 9);
+
+    // Both are clocked so that a loop takes one tick, so compare the times in ticks.
+    double standardTicks = (double)(standardResult.endCycle - standardStart) / 8;
+    double earlyExitTicks = (double)(earlyExitResult.endCycle - earlyExitStart) / 9;
+    printf("Bright surface read: standard %.0f ticks, early exit %.0f ticks (%.1fx quicker)\n",
+           standardTicks, earlyExitTicks, standardTicks / earlyExitTicks);
+    CHECK ( standardTicks / earlyExitTicks > 5.0 );
+}
+
+static void testInactiveSensorsDontHoldOffEarlyExit()
+{
+    const uint32_t timeoutTicks = 1024;
+    // The inactive sensors would never discharge but they are held low by the PIO so they don't count.
+    const uint32_t discharge[sensorCount] = { neverDischarges, neverDischarges, 50, 60, 70, 80, 90 };
+    const uint32_t lineSensorsMask = 0x7C;
+    QTRProgram earlyExit = createEarlyExit();
+
+    uint64_t start = earlyExit.getCycle();
+    ReadResult result = earlyExit.read(discharge, lineSensorsMask, timeoutTicks, 32 * 9);
+    checkReadings("RP2040QTREarlyExit", result, discharge, lineSensorsMask, timeoutTicks);
+    CHECK ( (result.endCycle - start) / 9 <= 32 + 90 + 3 );
+}
+
+static void testTimeoutStillApplies()
+{
+    const uint32_t timeoutTicks = 200;
+    const uint32_t discharge[sensorCount] = { 10, 20, neverDischarges, 40, 50, 60, 70 };
+    QTRProgram earlyExit = createEarlyExit();
+
+    uint64_t start = earlyExit.getCycle();
+    ReadResult result = earlyExit.read(discharge, allSensorsMask, timeoutTicks, 32 * 9);
+    checkReadings("RP2040QTREarlyExit", result, discharge, allSensorsMask, timeoutTicks);
+    CHECK_EQUAL ( timeoutTicks, result.readings[2] );
+    CHECK ( (result.endCycle - start) / 9 >= 32 + timeoutTicks );
+}
+
+int main(void)
+{
+    testSameReadingsAsStandardProgram();
+    testBrightSurfaceIsMuchQuicker();
+    testInactiveSensorsDontHoldOffEarlyExit();
+    testTimeoutStillApplies();
+
+    return reportTestResults("QTREarlyExitTest");
+}
@@ -0,0 +1,177 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Runs the RP2040QTR and RP2040QTREarlyExit PIO programs from RP2040QTR.pio.h on the PIO simulator, with a simple
+// model of the sensor capacitors discharging.
+#pragma once
+
+#include <vector>
+#include "PioStateMachine.h"
+#include "RP2040QTR.pio.h"
+
+
+static const uint32_t sensorCount = 7;
+static const uint32_t allSensorsMask = (1 << sensorCount) - 1;
+// The tick at which a sensor that never discharges would.
+static const uint32_t neverDischarges = 0xFFFFFFFF;
+
+struct ReadResult
+{
+    uint16_t readings[sensorCount];
+    // Cycle at which the terminator was pushed.
+    uint64_t endCycle;
+    bool     completed;
+};
+
+class QTRProgram
+{
+    public:
+        QTRProgram(const uint16_t* pInstructions, uint32_t length, uint32_t wrapTarget, uint32_t wrap,
+                   uint32_t loopCycles)
+        : m_sm(pInstructions, length, wrapTarget, wrap)
+        {
+            m_loopCycles = loopCycles;
+            // Configured the same way as QTRSensors::initStateMachine() with the pins relative to the base.
+            m_sm.setInShift(false, true, 23);
+            m_sm.setOutPinCount(sensorCount);
+            m_sm.setFifoDepths(4, 4);
+            m_sm.setPinReader([this](const PioStateMachine& sm) { return readPins(sm); });
+            for (uint32_t i = 0 ; i < sensorCount ; i++)
+            {
+                m_releaseCycle[i] = 0;
+                m_dischargeCycles[i] = 0;
+            }
+        }
+
+        // Runs a complete read of the sensors in 'mask' which discharge the given number of ticks after they are
+        // released. Like QTRSensors, the previous read is left waiting on its IRQ flag and this one is started by
+        // queueing the configuration word and clearing the flag.
+        ReadResult read(const uint32_t dischargeTicks[sensorCount], uint32_t mask, uint32_t timeoutTicks,
+                        uint32_t chargeCycles)
+        {
+            for (uint32_t i = 0 ; i < sensorCount ; i++)
+            {
+                uint32_t ticks = dischargeTicks[i];
+                m_dischargeCycles[i] = (ticks == neverDischarges) ? 0xFFFFFFFFFFFFull : (uint64_t)ticks * m_loopCycles;
+            }
+            m_sm.setPins(mask, allSensorsMask);
+            m_sm.putTx(((timeoutTicks - 1) << 16) | (chargeCycles - 1));
+            m_sm.clearIrq(0);
+
+            ReadResult result;
+            uint32_t pending = mask;
+            for (uint32_t i = 0 ; i < sensorCount ; i++)
+            {
+                result.readings[i] = (mask & (1 << i)) ? timeoutTicks : 0;
+            }
+            result.completed = false;
+            result.endCycle = 0;
+            m_events.clear();
+
+            uint64_t cycleLimit = m_sm.getCycle() + chargeCycles + (uint64_t)(timeoutTicks + 16) * m_loopCycles;
+            uint32_t lastDirs = m_sm.getPinDirs();
+            while (m_sm.getCycle() < cycleLimit)
+            {
+                m_sm.step();
+
+                // Note when each pin is released to start discharging.
+                uint32_t dirs = m_sm.getPinDirs();
+                uint32_t released = lastDirs & ~dirs;
+                for (uint32_t i = 0 ; i < sensorCount ; i++)
+                {
+                    if (released & (1 << i))
+                    {
+                        m_releaseCycle[i] = m_sm.getCycle();
+                    }
+                }
+                lastDirs = dirs;
+
+                while (!m_sm.isRxEmpty())
+                {
+                    uint32_t event = m_sm.getRx();
+                    m_events.push_back(event);
+                    if (event == 0xFFFFFFFF)
+                    {
+                        result.completed = true;
+                        result.endCycle = m_sm.getCycle();
+                        continue;
+                    }
+                    // Decoded the same way as QTRSensors::decodeEvent().
+                    uint32_t discharged = pending & ~(event >> 16);
+                    pending &= ~discharged;
+                    for (uint32_t i = 0 ; i < sensorCount ; i++)
+                    {
+                        if (discharged & (1 << i))
+                        {
+                            result.readings[i] = timeoutTicks - (event & 0xFFFF);
+                        }
+                    }
+                }
+                if (result.completed && m_sm.isIrqSet(0) && m_sm.isStalled())
+                {
+                    break;
+                }
+            }
+            return result;
+        }
+
+        uint64_t getCycle()
+        {
+            return m_sm.getCycle();
+        }
+
+        // The raw FIFO events pushed by the last read, including the terminator, as the DMA channel would have
+        // copied them into QTRSensors' event ring.
+        const std::vector<uint32_t>& getEvents()
+        {
+            return m_events;
+        }
+
+    protected:
+        uint32_t readPins(const PioStateMachine& sm)
+        {
+            uint32_t dirs = sm.getPinDirs();
+            uint32_t pins = sm.getPinValues() & dirs;
+            for (uint32_t i = 0 ; i < sensorCount ; i++)
+            {
+                uint32_t bit = 1 << i;
+                if ((dirs & bit) == 0 && sm.getCycle() - m_releaseCycle[i] < m_dischargeCycles[i])
+                {
+                    pins |= bit;
+                }
+            }
+            return pins;
+        }
+
+        PioStateMachine       m_sm;
+        uint32_t              m_loopCycles;
+        uint64_t              m_releaseCycle[sensorCount];
+        uint64_t              m_dischargeCycles[sensorCount];
+        std::vector<uint32_t> m_events;
+};
+
+static QTRProgram createStandard()
+{
+    return QTRProgram(RP2040QTR_program_instructions,
+                      sizeof(RP2040QTR_program_instructions) / sizeof(RP2040QTR_program_instructions[0]),
+                      RP2040QTR_wrap_target, RP2040QTR_wrap, 8);
+}
+
+static QTRProgram createEarlyExit()
+{
+    return QTRProgram(RP2040QTREarlyExit_program_instructions,
+                      sizeof(RP2040QTREarlyExit_program_instructions) /
+                      sizeof(RP2040QTREarlyExit_program_instructions[0]),
+                      RP2040QTREarlyExit_wrap_target, RP2040QTREarlyExit_wrap, 9);
+}
@@ -0,0 +1,54 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Minimal assertion macros shared by the host tests. Failures are counted rather than aborting so that each run
+// reports every failed check.
+#pragma once
+
+#include <stdio.h>
+
+static int g_testFailures = 0;
+static int g_testChecks = 0;
+
+#define CHECK(X) \
+    do \
+    { \
+        g_testChecks++; \
+        if (!(X)) \
+        { \
+            g_testFailures++; \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #X); \
+        } \
+    } while (0)
+
+#define CHECK_EQUAL(EXPECTED, ACTUAL) \
+    do \
+    { \
+        g_testChecks++; \
+        long long expected = (long long)(EXPECTED); \
+        long long actual = (long long)(ACTUAL); \
+        if (expected != actual) \
+        { \
+            g_testFailures++; \
+            printf("%s:%d: CHECK_EQUAL(%s, %s) failed: expected %lld but was %lld\n", \
+                   __FILE__, __LINE__, #EXPECTED, #ACTUAL, expected, actual); \
+        } \
+    } while (0)
+
+// Returns the exit code for main().
+static inline int reportTestResults(const char* pName)
+{
+    printf("%s: %d checks, %d failures\n", pName, g_testChecks, g_testFailures);
+    return g_testFailures ? 1 : 0;
+}
@@ -0,0 +1,33 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Host stand-in for the parts of the Arduino-Pico core used by the library code under test. The hardware headers in
+// this directory model just enough of the Pico SDK for that code to run on the host, with mock*() functions that let
+// the tests play the part of the hardware.
+#pragma once
+
+#include <assert.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <hardware/gpio.h>
+#include <hardware/pio.h>
+#include <hardware/sync.h>
+
+#define ARDUINO_ARCH_RP2040 1
+
+#define __not_in_flash_func(X) X
+
+#define constrain(AMT, LOW, HIGH) ((AMT) < (LOW) ? (LOW) : ((AMT) > (HIGH) ? (HIGH) : (AMT)))
@@ -0,0 +1,29 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Host mock of the Pico SDK's hardware/clocks.h. The system clock runs at the Arduino-Pico default of 125MHz.
+#pragma once
+
+#include <stdint.h>
+
+enum clock_index
+{
+    clk_sys = 5
+};
+
+static inline uint32_t clock_get_hz(enum clock_index clockIndex)
+{
+    (void)clockIndex;
+    return 125000000;
+}
@@ -0,0 +1,260 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Host mock of the Pico SDK's hardware/dma.h. Paced channels only move a word when the test calls
+// mockDmaTransfer(), as if their DREQ had fired. Unpaced channels, such as the control channels which rewrite another
+// channel's registers, run to completion as soon as they are triggered. Channels chain, wrap their write address
+// within a ring, reload their transfer count when restarted, and raise DMA_IRQ_0 on completion like the real thing.
+// The registers are only 32 bits wide so the full host addresses are kept alongside them.
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <hardware/irq.h>
+
+typedef unsigned int uint;
+
+#define NUM_DMA_CHANNELS 12
+#define DREQ_FORCE 0x3f
+
+typedef struct
+{
+    volatile uint32_t read_addr;
+    volatile uint32_t write_addr;
+    volatile uint32_t transfer_count;
+    volatile uint32_t ctrl_trig;
+    volatile uint32_t al1_ctrl;
+    volatile uint32_t al1_read_addr;
+    volatile uint32_t al1_write_addr;
+    volatile uint32_t al1_transfer_count_trig;
+} dma_channel_hw_t;
+
+typedef struct
+{
+    dma_channel_hw_t ch[NUM_DMA_CHANNELS];
+    volatile uint32_t ints0;
+    volatile uint32_t inte0;
+} dma_hw_t;
+
+typedef struct
+{
+    bool     readIncrement;
+    bool     writeIncrement;
+    uint32_t dreq;
+    uint32_t chainTo;
+    uint32_t ringSizeBits;
+    bool     ringWrite;
+} dma_channel_config;
+
+typedef struct
+{
+    volatile uintptr_t readAddr;
+    volatile uintptr_t writeAddr;
+    dma_channel_config config;
+    uint32_t           reloadCount;
+    uint64_t           totalTransfers;
+    bool               claimed;
+    bool               busy;
+} MockDmaChannel;
+
+inline dma_hw_t       g_mockDmaHw;
+inline MockDmaChannel g_mockDmaChannels[NUM_DMA_CHANNELS];
+#define dma_hw (&g_mockDmaHw)
+
+static inline int dma_claim_unused_channel(bool required)
+{
+    for (int channel = 0 ; channel < NUM_DMA_CHANNELS ; channel++)
+    {
+        if (!g_mockDmaChannels[channel].claimed)
+        {
+            g_mockDmaChannels[channel].claimed = true;
+            return channel;
+        }
+    }
+    assert ( !required );
+    return -1;
+}
+
+static inline void dma_channel_unclaim(uint channel)
+{
+    g_mockDmaChannels[channel].claimed = false;
+}
+
+static inline dma_channel_hw_t* dma_channel_hw_addr(uint channel)
+{
+    return &dma_hw->ch[channel];
+}
+
+static inline dma_channel_config dma_channel_get_default_config(uint channel)
+{
+    dma_channel_config config = { true, false, DREQ_FORCE, channel, 0, false };
+    return config;
+}
+
+static inline void channel_config_set_read_increment(dma_channel_config* pConfig, bool increment)
+{
+    pConfig->readIncrement = increment;
+}
+
+static inline void channel_config_set_write_increment(dma_channel_config* pConfig, bool increment)
+{
+    pConfig->writeIncrement = increment;
+}
+
+static inline void channel_config_set_dreq(dma_channel_config* pConfig, uint dreq)
+{
+    pConfig->dreq = dreq;
+}
+
+static inline void channel_config_set_chain_to(dma_channel_config* pConfig, uint chainTo)
+{
+    pConfig->chainTo = chainTo;
+}
+
+static inline void channel_config_set_ring(dma_channel_config* pConfig, bool write, uint sizeBits)
+{
+    pConfig->ringWrite = write;
+    pConfig->ringSizeBits = sizeBits;
+}
+
+static inline void mockDmaRun(uint channel);
+
+static inline void dma_channel_start(uint channel)
+{
+    MockDmaChannel* pChannel = &g_mockDmaChannels[channel];
+    dma_hw->ch[channel].transfer_count = pChannel->reloadCount;
+    pChannel->busy = pChannel->reloadCount != 0;
+    if (pChannel->config.dreq == DREQ_FORCE)
+    {
+        mockDmaRun(channel);
+    }
+}
+
+static inline void dma_channel_abort(uint channel)
+{
+    g_mockDmaChannels[channel].busy = false;
+}
+
+static inline void dma_channel_configure(uint channel, const dma_channel_config* pConfig, volatile void* pWrite,
+                                         const volatile void* pRead, uint transferCount, bool trigger)
+{
+    MockDmaChannel* pChannel = &g_mockDmaChannels[channel];
+    pChannel->config = *pConfig;
+    pChannel->writeAddr = (uintptr_t)pWrite;
+    pChannel->readAddr = (uintptr_t)pRead;
+    pChannel->reloadCount = transferCount;
+    dma_hw->ch[channel].write_addr = (uint32_t)(uintptr_t)pWrite;
+    dma_hw->ch[channel].read_addr = (uint32_t)(uintptr_t)pRead;
+    dma_hw->ch[channel].transfer_count = transferCount;
+    if (trigger)
+    {
+        dma_channel_start(channel);
+    }
+}
+
+static inline void dma_channel_set_irq0_enabled(uint channel, bool enabled)
+{
+    if (enabled)
+    {
+        dma_hw->inte0 |= 1 << channel;
+    }
+    else
+    {
+        dma_hw->inte0 &= ~(1 << channel);
+    }
+}
+
+static inline bool dma_channel_get_irq0_status(uint channel)
+{
+    return (dma_hw->ints0 & (1 << channel)) != 0;
+}
+
+static inline void dma_channel_acknowledge_irq0(uint channel)
+{
+    dma_hw->ints0 &= ~(1 << channel);
+}
+
+static inline bool mockDmaIsBusy(uint channel)
+{
+    return g_mockDmaChannels[channel].busy;
+}
+
+// Number of words that the channel has moved since the test started.
+static inline uint64_t mockDmaTotalTransfers(uint channel)
+{
+    return g_mockDmaChannels[channel].totalTransfers;
+}
+
+// Moves one word for a busy channel, as if its DREQ had fired. Returns false if the channel isn't busy, in which case
+// the word would have been left in the peripheral's FIFO.
+static inline bool mockDmaTransfer(uint channel)
+{
+    MockDmaChannel* pChannel = &g_mockDmaChannels[channel];
+    dma_channel_hw_t* pHw = &dma_hw->ch[channel];
+    if (!pChannel->busy)
+    {
+        return false;
+    }
+
+    uint32_t value = *(volatile uint32_t*)pChannel->readAddr;
+    volatile uint32_t* pDest = (volatile uint32_t*)pChannel->writeAddr;
+    *pDest = value;
+    // Writes to another channel's trigger alias start it with the new transfer count.
+    uintptr_t channelOffset = (uintptr_t)pDest - (uintptr_t)&dma_hw->ch[0];
+    if (channelOffset < sizeof(dma_hw->ch) &&
+        channelOffset % sizeof(dma_hw->ch[0]) == offsetof(dma_channel_hw_t, al1_transfer_count_trig))
+    {
+        uint other = channelOffset / sizeof(dma_hw->ch[0]);
+        g_mockDmaChannels[other].reloadCount = value;
+        dma_channel_start(other);
+    }
+
+    const dma_channel_config& config = pChannel->config;
+    if (config.readIncrement)
+    {
+        uintptr_t mask = (config.ringSizeBits && !config.ringWrite) ? (1 << config.ringSizeBits) - 1 : ~(uintptr_t)0;
+        pChannel->readAddr = (pChannel->readAddr & ~mask) | ((pChannel->readAddr + 4) & mask);
+    }
+    if (config.writeIncrement)
+    {
+        uintptr_t mask = (config.ringSizeBits && config.ringWrite) ? (1 << config.ringSizeBits) - 1 : ~(uintptr_t)0;
+        pChannel->writeAddr = (pChannel->writeAddr & ~mask) | ((pChannel->writeAddr + 4) & mask);
+    }
+    pHw->read_addr = (uint32_t)pChannel->readAddr;
+    pHw->write_addr = (uint32_t)pChannel->writeAddr;
+    pChannel->totalTransfers++;
+
+    if (--pHw->transfer_count == 0)
+    {
+        pChannel->busy = false;
+        if (config.chainTo != channel)
+        {
+            dma_channel_start(config.chainTo);
+        }
+        if (dma_hw->inte0 & (1 << channel))
+        {
+            dma_hw->ints0 |= 1 << channel;
+            mockIrqRaise(DMA_IRQ_0);
+        }
+    }
+    return true;
+}
+
+static inline void mockDmaRun(uint channel)
+{
+    while (mockDmaTransfer(channel))
+    {
+    }
+}
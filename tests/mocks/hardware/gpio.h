@@ -0,0 +1,63 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Host mock of the Pico SDK's hardware/gpio.h. The SIO registers are plain memory and the pad configuration is
+// ignored.
+#pragma once
+
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+enum gpio_function
+{
+    GPIO_FUNC_SPI = 1,
+    GPIO_FUNC_PWM = 4,
+    GPIO_FUNC_SIO = 5,
+    GPIO_FUNC_PIO0 = 6,
+    GPIO_FUNC_PIO1 = 7,
+    GPIO_FUNC_NULL = 0x1f
+};
+
+typedef struct
+{
+    volatile uint32_t cpuid;
+    volatile uint32_t gpio_in;
+    volatile uint32_t gpio_hi_in;
+    volatile uint32_t _pad;
+    volatile uint32_t gpio_out;
+    volatile uint32_t gpio_set;
+    volatile uint32_t gpio_clr;
+    volatile uint32_t gpio_togl;
+    volatile uint32_t gpio_oe;
+    volatile uint32_t gpio_oe_set;
+    volatile uint32_t gpio_oe_clr;
+    volatile uint32_t gpio_oe_togl;
+} sio_hw_t;
+
+inline sio_hw_t g_mockSioHw;
+#define sio_hw (&g_mockSioHw)
+
+static inline void gpio_set_function(uint gpio, enum gpio_function fn)
+{
+    (void)gpio;
+    (void)fn;
+}
+
+static inline void gpio_set_pulls(uint gpio, bool up, bool down)
+{
+    (void)gpio;
+    (void)up;
+    (void)down;
+}
@@ -0,0 +1,96 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Host mock of the Pico SDK's hardware/irq.h. The mocked peripherals call mockIrqRaise() where the hardware would
+// interrupt the CPU and it runs the registered handlers right away if the IRQ is enabled. Otherwise the IRQ is left
+// pending and the handlers run when it is enabled again.
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+typedef void (*irq_handler_t)(void);
+
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+
+#define PIO0_IRQ_0 7
+#define PIO0_IRQ_1 8
+#define PIO1_IRQ_0 9
+#define PIO1_IRQ_1 10
+#define DMA_IRQ_0  11
+#define DMA_IRQ_1  12
+
+static const uint mockIrqCount = 32;
+static const uint mockMaxSharedHandlers = 4;
+
+inline irq_handler_t g_mockIrqHandlers[mockIrqCount][mockMaxSharedHandlers];
+inline bool          g_mockIrqEnabled[mockIrqCount];
+inline bool          g_mockIrqPending[mockIrqCount];
+
+static inline void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t orderPriority)
+{
+    (void)orderPriority;
+    for (uint i = 0 ; i < mockMaxSharedHandlers ; i++)
+    {
+        if (g_mockIrqHandlers[num][i] == NULL)
+        {
+            g_mockIrqHandlers[num][i] = handler;
+            return;
+        }
+    }
+    assert ( !"Too many shared handlers" );
+}
+
+static inline void irq_remove_handler(uint num, irq_handler_t handler)
+{
+    for (uint i = 0 ; i < mockMaxSharedHandlers ; i++)
+    {
+        if (g_mockIrqHandlers[num][i] == handler)
+        {
+            g_mockIrqHandlers[num][i] = NULL;
+        }
+    }
+}
+
+static inline void mockIrqRunHandlers(uint num)
+{
+    g_mockIrqPending[num] = false;
+    for (uint i = 0 ; i < mockMaxSharedHandlers ; i++)
+    {
+        if (g_mockIrqHandlers[num][i] != NULL)
+        {
+            g_mockIrqHandlers[num][i]();
+        }
+    }
+}
+
+static inline void mockIrqRaise(uint num)
+{
+    g_mockIrqPending[num] = true;
+    if (g_mockIrqEnabled[num])
+    {
+        mockIrqRunHandlers(num);
+    }
+}
+
+static inline void irq_set_enabled(uint num, bool enabled)
+{
+    g_mockIrqEnabled[num] = enabled;
+    if (enabled && g_mockIrqPending[num])
+    {
+        mockIrqRunHandlers(num);
+    }
+}
@@ -0,0 +1,313 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Host mock of the Pico SDK's hardware/pio.h. It keeps track of the program memory and state machines which have
+// been claimed but doesn't run any PIO code. PioStateMachine.h is used for that instead. Writes to the TX FIFO are
+// left in the txf register and the IRQ flags are set by the tests with mockPioSetIrq().
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+typedef struct
+{
+    volatile uint32_t clkdiv;
+    volatile uint32_t execctrl;
+    volatile uint32_t shiftctrl;
+    volatile uint32_t addr;
+    volatile uint32_t instr;
+    volatile uint32_t pinctrl;
+} pio_sm_hw_t;
+
+typedef struct
+{
+    volatile uint32_t ctrl;
+    volatile uint32_t fstat;
+    volatile uint32_t fdebug;
+    volatile uint32_t flevel;
+    volatile uint32_t txf[4];
+    volatile uint32_t rxf[4];
+    volatile uint32_t irq;
+    volatile uint32_t irq_force;
+    volatile uint32_t input_sync_bypass;
+    volatile uint32_t dbg_padout;
+    volatile uint32_t dbg_padoe;
+    volatile uint32_t dbg_cfginfo;
+    volatile uint32_t instr_mem[32];
+    pio_sm_hw_t       sm[4];
+} pio_hw_t;
+
+typedef pio_hw_t* PIO;
+
+inline pio_hw_t g_mockPioHw[2];
+#define pio0 (&g_mockPioHw[0])
+#define pio1 (&g_mockPioHw[1])
+
+typedef struct
+{
+    uint32_t clkdiv;
+    uint32_t execctrl;
+    uint32_t shiftctrl;
+    uint32_t pinctrl;
+} pio_sm_config;
+
+typedef struct pio_program
+{
+    const uint16_t* instructions;
+    uint8_t         length;
+    int8_t          origin;
+} pio_program_t;
+
+enum pio_src_dest
+{
+    pio_pins = 0,
+    pio_x = 1,
+    pio_y = 2,
+    pio_null = 3,
+    pio_pindirs = 4,
+    pio_status = 5,
+    pio_pc = 5,
+    pio_isr = 6,
+    pio_osr = 7
+};
+
+enum pio_fifo_join
+{
+    PIO_FIFO_JOIN_NONE = 0,
+    PIO_FIFO_JOIN_TX = 1,
+    PIO_FIFO_JOIN_RX = 2
+};
+
+enum pio_interrupt_source
+{
+    pis_interrupt0 = 8,
+    pis_interrupt1,
+    pis_interrupt2,
+    pis_interrupt3
+};
+
+// Which instruction slots are in use and which state machines have been claimed, for each PIO.
+inline uint32_t g_mockPioUsedInstructions[2];
+inline uint32_t g_mockPioClaimedStateMachines[2];
+inline uint32_t g_mockPioEnabledStateMachines[2];
+inline uint32_t g_mockPioIrq0SourcesEnabled[2];
+
+static inline uint pio_get_index(PIO pio)
+{
+    return pio == pio1 ? 1 : 0;
+}
+
+static inline int mockPioFindProgramOffset(PIO pio, const pio_program_t* pProgram)
+{
+    uint32_t programMask = (1ull << pProgram->length) - 1;
+    if (pProgram->origin >= 0)
+    {
+        return (g_mockPioUsedInstructions[pio_get_index(pio)] & (programMask << pProgram->origin)) ? -1 :
+               pProgram->origin;
+    }
+    // Like the SDK, fill the program memory from the top down.
+    for (int offset = 32 - pProgram->length ; offset >= 0 ; offset--)
+    {
+        if ((g_mockPioUsedInstructions[pio_get_index(pio)] & (programMask << offset)) == 0)
+        {
+            return offset;
+        }
+    }
+    return -1;
+}
+
+static inline bool pio_can_add_program(PIO pio, const pio_program_t* pProgram)
+{
+    return mockPioFindProgramOffset(pio, pProgram) >= 0;
+}
+
+static inline uint pio_add_program(PIO pio, const pio_program_t* pProgram)
+{
+    int offset = mockPioFindProgramOffset(pio, pProgram);
+    assert ( offset >= 0 );
+    for (uint i = 0 ; i < pProgram->length ; i++)
+    {
+        pio->instr_mem[offset + i] = pProgram->instructions[i];
+    }
+    g_mockPioUsedInstructions[pio_get_index(pio)] |= (uint32_t)((1ull << pProgram->length) - 1) << offset;
+    return offset;
+}
+
+static inline void pio_remove_program(PIO pio, const pio_program_t* pProgram, uint offset)
+{
+    g_mockPioUsedInstructions[pio_get_index(pio)] &= ~((uint32_t)((1ull << pProgram->length) - 1) << offset);
+}
+
+static inline int pio_claim_unused_sm(PIO pio, bool required)
+{
+    for (int sm = 0 ; sm < 4 ; sm++)
+    {
+        if ((g_mockPioClaimedStateMachines[pio_get_index(pio)] & (1 << sm)) == 0)
+        {
+            g_mockPioClaimedStateMachines[pio_get_index(pio)] |= 1 << sm;
+            return sm;
+        }
+    }
+    assert ( !required );
+    return -1;
+}
+
+static inline void pio_sm_unclaim(PIO pio, uint sm)
+{
+    g_mockPioClaimedStateMachines[pio_get_index(pio)] &= ~(1 << sm);
+}
+
+static inline pio_sm_config pio_get_default_sm_config()
+{
+    pio_sm_config config = { 1 << 16, 31 << 12, (1 << 18) | (1 << 19), 0 };
+    return config;
+}
+
+static inline void sm_config_set_wrap(pio_sm_config* pConfig, uint wrapTarget, uint wrap)
+{
+    pConfig->execctrl = (pConfig->execctrl & ~0x1FF80) | (wrap << 12) | (wrapTarget << 7);
+}
+
+static inline void sm_config_set_in_shift(pio_sm_config* pConfig, bool shiftRight, bool autoPush, uint pushThreshold)
+{
+    pConfig->shiftctrl = (pConfig->shiftctrl & ~0x3E50000) | ((uint32_t)shiftRight << 18) |
+                         ((uint32_t)autoPush << 16) | ((pushThreshold & 0x1F) << 20);
+}
+
+static inline void sm_config_set_in_pins(pio_sm_config* pConfig, uint inBase)
+{
+    pConfig->pinctrl = (pConfig->pinctrl & ~0xF8000) | (inBase << 15);
+}
+
+static inline void sm_config_set_out_pins(pio_sm_config* pConfig, uint outBase, uint outCount)
+{
+    pConfig->pinctrl = (pConfig->pinctrl & ~0x3F0001F) | outBase | (outCount << 20);
+}
+
+static inline void sm_config_set_fifo_join(pio_sm_config* pConfig, enum pio_fifo_join join)
+{
+    pConfig->shiftctrl = (pConfig->shiftctrl & ~0xC0000000) | ((uint32_t)join << 30);
+}
+
+static inline void sm_config_set_clkdiv(pio_sm_config* pConfig, float div)
+{
+    pConfig->clkdiv = (uint32_t)(div * 65536.0f);
+}
+
+static inline int pio_sm_init(PIO pio, uint sm, uint initialPc, const pio_sm_config* pConfig)
+{
+    pio->sm[sm].clkdiv = pConfig->clkdiv;
+    pio->sm[sm].execctrl = pConfig->execctrl;
+    pio->sm[sm].shiftctrl = pConfig->shiftctrl;
+    pio->sm[sm].pinctrl = pConfig->pinctrl;
+    pio->sm[sm].addr = initialPc;
+    g_mockPioEnabledStateMachines[pio_get_index(pio)] &= ~(1 << sm);
+    return 0;
+}
+
+static inline void pio_gpio_init(PIO pio, uint pin)
+{
+    (void)pio;
+    (void)pin;
+}
+
+static inline void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t values, uint32_t mask)
+{
+    (void)sm;
+    pio->dbg_padout = (pio->dbg_padout & ~mask) | (values & mask);
+}
+
+static inline void pio_sm_set_enabled(PIO pio, uint sm, bool enabled)
+{
+    if (enabled)
+    {
+        g_mockPioEnabledStateMachines[pio_get_index(pio)] |= 1 << sm;
+    }
+    else
+    {
+        g_mockPioEnabledStateMachines[pio_get_index(pio)] &= ~(1 << sm);
+    }
+}
+
+static inline bool mockPioIsEnabled(PIO pio, uint sm)
+{
+    return (g_mockPioEnabledStateMachines[pio_get_index(pio)] & (1 << sm)) != 0;
+}
+
+static inline void pio_sm_restart(PIO pio, uint sm)
+{
+    (void)pio;
+    (void)sm;
+}
+
+static inline void pio_sm_clear_fifos(PIO pio, uint sm)
+{
+    pio->txf[sm] = 0;
+    pio->rxf[sm] = 0;
+}
+
+static inline void pio_sm_exec(PIO pio, uint sm, uint instruction)
+{
+    pio->sm[sm].instr = instruction;
+}
+
+static inline void pio_sm_put(PIO pio, uint sm, uint32_t data)
+{
+    pio->txf[sm] = data;
+}
+
+static inline uint pio_get_dreq(PIO pio, uint sm, bool isTx)
+{
+    return pio_get_index(pio) * 8 + sm + (isTx ? 0 : 4);
+}
+
+static inline void pio_set_irq0_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled)
+{
+    if (enabled)
+    {
+        g_mockPioIrq0SourcesEnabled[pio_get_index(pio)] |= 1 << source;
+    }
+    else
+    {
+        g_mockPioIrq0SourcesEnabled[pio_get_index(pio)] &= ~(1 << source);
+    }
+}
+
+static inline bool pio_interrupt_get(PIO pio, uint irqIndex)
+{
+    return (pio->irq & (1 << irqIndex)) != 0;
+}
+
+static inline void pio_interrupt_clear(PIO pio, uint irqIndex)
+{
+    pio->irq &= ~(1 << irqIndex);
+}
+
+// Sets a state machine's IRQ flag the way that an "irq" instruction would.
+static inline void mockPioSetIrq(PIO pio, uint irqIndex)
+{
+    pio->irq |= 1 << irqIndex;
+}
+
+static inline uint pio_encode_jmp(uint addr)
+{
+    return 0x0000 | addr;
+}
+
+static inline uint pio_encode_mov_not(enum pio_src_dest dest, enum pio_src_dest src)
+{
+    return 0xA000 | ((uint)dest << 5) | (1 << 3) | (uint)src;
+}
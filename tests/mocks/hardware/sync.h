@@ -0,0 +1,79 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Host mock of the Pico SDK's hardware/sync.h. The tests are single threaded so a spin lock which is already held
+// when it is taken again can only mean a missing unlock or a handler being run with the lock held, and it asserts.
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+typedef volatile uint32_t spin_lock_t;
+
+// The SDK's hardware headers all pull this in from pico.h.
+#define hard_assert assert
+
+#define __dmb() __sync_synchronize()
+
+static const uint mockSpinLockCount = 32;
+
+inline spin_lock_t g_mockSpinLocks[mockSpinLockCount];
+inline bool        g_mockSpinLocksClaimed[mockSpinLockCount];
+
+static inline int spin_lock_claim_unused(bool required)
+{
+    // The SDK reserves the lower half for its own use.
+    for (uint i = mockSpinLockCount / 2 ; i < mockSpinLockCount ; i++)
+    {
+        if (!g_mockSpinLocksClaimed[i])
+        {
+            g_mockSpinLocksClaimed[i] = true;
+            return i;
+        }
+    }
+    assert ( !required );
+    return -1;
+}
+
+static inline spin_lock_t* spin_lock_init(uint lockNum)
+{
+    g_mockSpinLocks[lockNum] = 0;
+    return &g_mockSpinLocks[lockNum];
+}
+
+static inline uint32_t save_and_disable_interrupts()
+{
+    return 0;
+}
+
+static inline void restore_interrupts(uint32_t status)
+{
+    (void)status;
+}
+
+static inline uint32_t spin_lock_blocking(spin_lock_t* pLock)
+{
+    assert ( *pLock == 0 );
+    *pLock = 1;
+    return save_and_disable_interrupts();
+}
+
+static inline void spin_unlock(spin_lock_t* pLock, uint32_t savedIrq)
+{
+    assert ( *pLock != 0 );
+    *pLock = 0;
+    restore_interrupts(savedIrq);
+}
@@ -0,0 +1,35 @@
+/* Copyright 2023 Adam Green (https://github.com/adamgreen/)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Host mock of the Pico SDK's hardware/timer.h. Time only moves when a test sets it with mockSetTimeUs().
+#pragma once
+
+#include <stdint.h>
+
+inline uint64_t g_mockTimeUs = 0;
+
+static inline void mockSetTimeUs(uint64_t timeUs)
+{
+    g_mockTimeUs = timeUs;
+}
+
+static inline uint64_t time_us_64()
+{
+    return g_mockTimeUs;
+}
+
+static inline uint32_t time_us_32()
+{
+    return (uint32_t)g_mockTimeUs;
+}